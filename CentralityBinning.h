@@ -0,0 +1,131 @@
+/*
+ * CentralityBinning.h
+ *
+ * class to find the centrality bin of an event from its centrality variable, hiBin for HI events or hf4sum for pA events.
+ * Bins are given by their edges, e.g. {0, 20, 60, 100, 200} in hiBin for 0-10/10-30/30-50/50-100 %.
+ *
+ * The bin is found with a lookup table on a uniform grid whose cells are not wider than the narrowest bin,
+ * so a cell overlaps at most two bins and a single comparison with the next edge gives the bin.
+ */
+
+#ifndef CENTRALITYBINNING_H_
+#define CENTRALITYBINNING_H_
+
+#include <TString.h>
+#include <TMath.h>
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "EventViews.h"
+
+class CentralityBinning {
+public:
+    CentralityBinning(int variable, int nBins, const float binEdges[]);
+    virtual ~CentralityBinning();
+
+    int     getBin(float value) const;
+    int     getNBins() const;
+    int     getVariable() const;
+    float   getLowEdge(int bin) const;
+    float   getUpEdge(int bin) const;
+    TString getBinLabel(int bin) const;
+
+private:
+    static const int maxCells = 100000;
+
+    int variable;               // centrality_hiBin or centrality_hf4sum
+    std::vector<float> edges;
+    std::vector<int>   lookup;  // bin of the lower edge of each cell
+    float cellWidth;
+};
+
+/*
+ * "binEdges" has nBins+1 increasing values, the lower edge is included in a bin, the upper edge is not.
+ */
+CentralityBinning::CentralityBinning(int variable, int nBins, const float binEdges[])
+{
+    this->variable = variable;
+    if (variable != centrality_hiBin && variable != centrality_hf4sum) {
+        std::cout << "CentralityBinning : centrality variable must be centrality_hiBin or centrality_hf4sum." << std::endl;
+    }
+
+    for (int i = 0; i <= nBins; ++i) {
+        if (i > 0 && binEdges[i] <= binEdges[i-1]) {
+            std::cout << "CentralityBinning : bin edges are not increasing, no bin is defined." << std::endl;
+            edges.clear();
+            return;
+        }
+        edges.push_back(binEdges[i]);
+    }
+    if (nBins <= 0)  {
+        edges.clear();
+        return;
+    }
+
+    float minWidth = edges[1] - edges[0];
+    for (int i = 1; i < nBins; ++i) {
+        minWidth = TMath::Min(minWidth, edges[i+1] - edges[i]);
+    }
+    float range = edges[nBins] - edges[0];
+    int nCells = TMath::Min((int)TMath::Ceil(range / minWidth), maxCells);
+    cellWidth = range / nCells;
+
+    lookup.resize(nCells);
+    for (int c = 0; c < nCells; ++c) {
+        float low = edges[0] + c * cellWidth;
+        lookup[c] = std::upper_bound(edges.begin(), edges.end(), low) - edges.begin() - 1;
+    }
+}
+
+CentralityBinning::~CentralityBinning()
+{
+}
+
+/*
+ * index of the bin that contains "value", -1 if "value" is outside the bins
+ */
+int CentralityBinning::getBin(float value) const
+{
+    const int nBins = getNBins();
+    if (nBins <= 0 || value < edges[0] || value >= edges[nBins])  return -1;
+
+    int cell = TMath::Min((int)((value - edges[0]) / cellWidth), (int)lookup.size() - 1);
+    int bin = lookup[cell];
+    // a cell spans at most two bins, unless the number of cells was limited by "maxCells"
+    while (bin + 1 < nBins && value >= edges[bin+1])  ++bin;
+    while (bin > 0 && value < edges[bin])  --bin;
+    return bin;
+}
+
+int CentralityBinning::getNBins() const
+{
+    return (edges.size() > 0) ? edges.size() - 1 : 0;
+}
+
+int CentralityBinning::getVariable() const
+{
+    return variable;
+}
+
+float CentralityBinning::getLowEdge(int bin) const
+{
+    return edges[bin];
+}
+
+float CentralityBinning::getUpEdge(int bin) const
+{
+    return edges[bin+1];
+}
+
+/*
+ * label of a bin to be used in histogram names, e.g. "hiBin0_20" or "hf4sum20_30"
+ */
+TString CentralityBinning::getBinLabel(int bin) const
+{
+    const char* name = (variable == centrality_hiBin) ? "hiBin" : "hf4sum";
+    return Form("%s%g_%g", name, edges[bin], edges[bin+1]);
+}
+
+#endif /* CENTRALITYBINNING_H_ */
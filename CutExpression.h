@@ -0,0 +1,599 @@
+/*
+ * CutExpression.h
+ *
+ * class to hold a selection, e.g. "pt > 40 && abs(eta) < 1.44", as an expression tree of "&&", "||" and "!"
+ * whose leaves are the terms of the selection, e.g. "pt > 40".
+ * Merging selections as strings repeats terms and tautologies like "1" or "1==1", simplify() removes them :
+ *  - constant terms are evaluated, "1", "1==1" are true, "0" is false. Other numbers are true or false if they are
+ *    operands of "&&", "||" or "!", e.g. "0.5 && A" is "A", but a selection that is only a number, e.g. "0.5", is a weight
+ *  - nested "&&" or "||" are flattened, duplicate terms are removed, whitespace does not matter for the comparison of terms
+ *  - absorption : "A && (A || B)" is "A", "A || (A && B)" is "A"
+ *  - common terms are factored out : "(A && B) || (A && C)" is "A && (B || C)"
+ *  - selections inside parentheses of a term, e.g. the condition in "Max$(pt*(A && A))", are simplified as well
+ * toString() gives the minimal selection string to be used in TTree::Draw() or TTreeFormula.
+ *
+ * A term that is not a comparison keeps its value only if the selection is the term itself, e.g. "w" is a weight in TTree::Draw().
+ * If the term comes from a logical expression, it is written as "(w) != 0" so that the value is still 0 or 1,
+ * e.g. "1 && w" is "(w) != 0" and "A && w" is "A && (w) != 0".
+ *
+ * usage :
+ *  CutExpression cut(cond_photon);
+ *  cut.merge(cond_pt_eta);
+ *  tree->Draw("pt", cut.toString());
+ */
+
+#ifndef CUTEXPRESSION_H_
+#define CUTEXPRESSION_H_
+
+#include <TString.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+enum cutNodeType {
+    cutNode_true,
+    cutNode_false,
+    cutNode_term,
+    cutNode_and,
+    cutNode_or,
+    cutNode_not
+};
+
+// node of a CutExpression
+struct cutNode {
+    int     type;
+    TString text;       // for terms only
+    std::vector<cutNode> children;
+};
+
+class CutExpression {
+public:
+    CutExpression();
+    CutExpression(const char* selection);
+    virtual ~CutExpression();
+
+    void    merge(const CutExpression& other);
+    void    mergeOr(const CutExpression& other);
+    void    simplify();
+    TString toString() const;
+    bool    isTrue() const;
+    bool    isFalse() const;
+    bool    isTerm() const;
+    bool    isEquivalent(const CutExpression& other) const;
+    std::vector<TString> getTerms() const;
+
+private:
+    cutNode root;
+};
+
+cutNode parseCutOr(TString text);
+cutNode parseCutAnd(TString text);
+cutNode parseCutUnary(TString text);
+void    simplifyCutNode(cutNode& node);
+void    evaluateCutConstant(cutNode& node);
+cutNode getCutOperand(const cutNode& node);
+TString getCutNodeKey(const cutNode& node);
+TString cutNodeToString(const cutNode& node);
+std::vector<int> findTopLevelOperators(const TString& text, char op);
+bool    isEnclosedInParentheses(const TString& text);
+bool    isBooleanTerm(const TString& text);
+bool    isLogicalExpression(const TString& text);
+bool    hasTopLevelComma(const TString& text);
+TString simplifyCutGroups(TString text);
+
+/*
+ * selection that accepts everything
+ */
+CutExpression::CutExpression()
+{
+    root.type = cutNode_true;
+}
+
+/*
+ * parse "selection", an empty selection accepts everything. The selection is not simplified.
+ */
+CutExpression::CutExpression(const char* selection)
+{
+    root = parseCutOr((selection != NULL) ? selection : "");
+}
+
+CutExpression::~CutExpression()
+{
+}
+
+/*
+ * this selection && "other"
+ */
+void CutExpression::merge(const CutExpression& other)
+{
+    cutNode node;
+    node.type = cutNode_and;
+    node.children.push_back(root);
+    node.children.push_back(other.root);
+    root = node;
+}
+
+/*
+ * this selection || "other"
+ */
+void CutExpression::mergeOr(const CutExpression& other)
+{
+    cutNode node;
+    node.type = cutNode_or;
+    node.children.push_back(root);
+    node.children.push_back(other.root);
+    root = node;
+}
+
+void CutExpression::simplify()
+{
+    simplifyCutNode(root);
+}
+
+/*
+ * selection string, "1" if the selection accepts everything, "0" if it accepts nothing
+ */
+TString CutExpression::toString() const
+{
+    return cutNodeToString(root);
+}
+
+bool CutExpression::isTrue() const
+{
+    return root.type == cutNode_true;
+}
+
+bool CutExpression::isFalse() const
+{
+    return root.type == cutNode_false;
+}
+
+/*
+ * true if the selection is a single term without "&&", "||" or "!", e.g. "w".
+ * Called before simplify(), it tells if TTree::Draw() uses the value of the selection as a weight.
+ */
+bool CutExpression::isTerm() const
+{
+    return root.type == cutNode_term;
+}
+
+/*
+ * true if the simplified selections have the same terms, irrespective of the order of the terms and whitespace
+ */
+bool CutExpression::isEquivalent(const CutExpression& other) const
+{
+    CutExpression cut1 = *this;
+    CutExpression cut2 = other;
+    cut1.simplify();
+    cut2.simplify();
+    return getCutNodeKey(cut1.root) == getCutNodeKey(cut2.root);
+}
+
+/*
+ * terms joined by "&&" at the top level of the selection, in order. empty if the selection accepts everything.
+ */
+std::vector<TString> CutExpression::getTerms() const
+{
+    std::vector<TString> terms;
+    if (root.type == cutNode_true)  return terms;
+
+    if (root.type == cutNode_and) {
+        for (unsigned i = 0; i < root.children.size(); ++i) {
+            terms.push_back(cutNodeToString(root.children[i]));
+        }
+    }
+    else {
+        terms.push_back(cutNodeToString(root));
+    }
+    return terms;
+}
+
+/*
+ * "||" has lower precedence than "&&", so the text is split at "||" first
+ */
+cutNode parseCutOr(TString text)
+{
+    std::vector<int> positions = findTopLevelOperators(text, '|');
+    if (positions.empty())  return parseCutAnd(text);
+
+    cutNode node;
+    node.type = cutNode_or;
+    int start = 0;
+    positions.push_back(text.Length());
+    for (unsigned i = 0; i < positions.size(); ++i) {
+        node.children.push_back(parseCutAnd(text(start, positions[i] - start)));
+        start = positions[i] + 2;
+    }
+    return node;
+}
+
+cutNode parseCutAnd(TString text)
+{
+    std::vector<int> positions = findTopLevelOperators(text, '&');
+    if (positions.empty())  return parseCutUnary(text);
+
+    cutNode node;
+    node.type = cutNode_and;
+    int start = 0;
+    positions.push_back(text.Length());
+    for (unsigned i = 0; i < positions.size(); ++i) {
+        node.children.push_back(parseCutUnary(text(start, positions[i] - start)));
+        start = positions[i] + 2;
+    }
+    return node;
+}
+
+/*
+ * "(...)", "!(...)" or a term
+ */
+cutNode parseCutUnary(TString text)
+{
+    text = text.Strip(TString::kBoth);
+
+    cutNode node;
+    if (text.Length() == 0) {
+        node.type = cutNode_true;
+    }
+    else if (isEnclosedInParentheses(text)) {
+        node = parseCutOr(text(1, text.Length() - 2));
+    }
+    else if (text[0] == '!' && text.Length() > 1 && text[1] != '=' && isEnclosedInParentheses(TString(text(1, text.Length() - 1)).Strip(TString::kBoth))) {
+        node.type = cutNode_not;
+        node.children.push_back(parseCutUnary(text(1, text.Length() - 1)));
+    }
+    else {
+        node.type = cutNode_term;
+        node.text = text;
+    }
+    return node;
+}
+
+void simplifyCutNode(cutNode& node)
+{
+    if (node.type == cutNode_true || node.type == cutNode_false)  return;
+
+    if (node.type == cutNode_term) {
+        node.text = simplifyCutGroups(node.text);
+
+        // constant terms
+        TString key = getCutNodeKey(node);
+        if (key == "1") {
+            node.type = cutNode_true;
+        }
+        else if (key == "0") {
+            node.type = cutNode_false;
+        }
+        else if (key.CountChar('=') == 2 && key.Index("==") > 0) {
+            // "X==X" is true, e.g. "1==1"
+            int i = key.Index("==");
+            if (key(0, i) == key(i + 2, key.Length() - i - 2) && key(0, i).Length() > 0) {
+                node.type = cutNode_true;
+            }
+        }
+        return;
+    }
+
+    if (node.type == cutNode_not) {
+        simplifyCutNode(node.children[0]);
+        evaluateCutConstant(node.children[0]);
+        cutNode child = node.children[0];
+        if (child.type == cutNode_true)        node.type = cutNode_false;
+        else if (child.type == cutNode_false)  node.type = cutNode_true;
+        else if (child.type == cutNode_not)    node = child.children[0];
+        if (node.type != cutNode_not)  node.children.clear();
+        return;
+    }
+
+    // "&&" or "||"
+    const bool isAnd = (node.type == cutNode_and);
+    const int neutral  = isAnd ? cutNode_true : cutNode_false;  // "A && true" is "A"
+    const int absorbing = isAnd ? cutNode_false : cutNode_true; // "A && false" is "false"
+    const int dual = isAnd ? cutNode_or : cutNode_and;
+
+    // simplify and flatten the children, remove neutral and duplicate children
+    std::vector<cutNode> children;
+    std::vector<TString> keys;
+    std::vector<cutNode> stack(node.children.rbegin(), node.children.rend());
+    while (!stack.empty()) {
+        cutNode child = stack.back();
+        stack.pop_back();
+        simplifyCutNode(child);
+        evaluateCutConstant(child);
+
+        if (child.type == node.type) {
+            for (int i = child.children.size() - 1; i >= 0; --i)  stack.push_back(child.children[i]);
+            continue;
+        }
+        if (child.type == neutral)  continue;
+        if (child.type == absorbing) {
+            node.type = absorbing;
+            node.children.clear();
+            return;
+        }
+
+        // "w" and "(w) != 0" are the same operand
+        TString key = getCutNodeKey(getCutOperand(child));
+        if (std::find(keys.begin(), keys.end(), key) != keys.end())  continue;
+        children.push_back(child);
+        keys.push_back(key);
+    }
+
+    // absorption : "A && (A || B)" is "A"
+    std::vector<cutNode> kept;
+    std::vector<TString> keptKeys;
+    for (unsigned i = 0; i < children.size(); ++i) {
+        bool absorbed = false;
+        if (children[i].type == dual) {
+            for (unsigned c = 0; c < children[i].children.size() && !absorbed; ++c) {
+                TString key = getCutNodeKey(children[i].children[c]);
+                absorbed = (std::find(keys.begin(), keys.end(), key) != keys.end());
+            }
+        }
+        if (absorbed)  continue;
+        kept.push_back(children[i]);
+        keptKeys.push_back(keys[i]);
+    }
+    children = kept;
+    keys = keptKeys;
+
+    // factor out common terms : "(A && B) || (A && C)" is "A && (B || C)"
+    if (!isAnd && children.size() > 1) {
+        std::vector<TString> common;
+        for (unsigned i = 0; i < children.size(); ++i) {
+            std::vector<TString> childKeys;
+            if (children[i].type == cutNode_and) {
+                for (unsigned c = 0; c < children[i].children.size(); ++c)  childKeys.push_back(getCutNodeKey(children[i].children[c]));
+            }
+            else {
+                childKeys.push_back(keys[i]);
+            }
+
+            if (i == 0) {
+                common = childKeys;
+                continue;
+            }
+            std::vector<TString> stillCommon;
+            for (unsigned k = 0; k < common.size(); ++k) {
+                if (std::find(childKeys.begin(), childKeys.end(), common[k]) != childKeys.end())  stillCommon.push_back(common[k]);
+            }
+            common = stillCommon;
+        }
+
+        if (!common.empty()) {
+            cutNode factored;
+            factored.type = cutNode_and;
+            cutNode rest;
+            rest.type = cutNode_or;
+            for (unsigned i = 0; i < children.size(); ++i) {
+                cutNode branch;
+                branch.type = cutNode_and;
+                const std::vector<cutNode>& terms = (children[i].type == cutNode_and) ? children[i].children
+                                                                                      : std::vector<cutNode>(1, children[i]);
+                for (unsigned c = 0; c < terms.size(); ++c) {
+                    TString key = getCutNodeKey(terms[c]);
+                    if (std::find(common.begin(), common.end(), key) != common.end()) {
+                        if (i == 0)  factored.children.push_back(terms[c]);
+                    }
+                    else {
+                        branch.children.push_back(terms[c]);
+                    }
+                }
+                rest.children.push_back(branch);
+            }
+            factored.children.push_back(rest);
+            simplifyCutNode(factored);
+            node = factored;
+            return;
+        }
+    }
+
+    node.children = children;
+    if (children.empty()) {
+        node.type = neutral;
+    }
+    else if (children.size() == 1) {
+        node = getCutOperand(children[0]);
+    }
+    else {
+        for (unsigned i = 0; i < node.children.size(); ++i)  node.children[i] = getCutOperand(node.children[i]);
+    }
+}
+
+/*
+ * a number that is an operand of a logical expression is true if it is nonzero, e.g. "0.5 && A" is "A"
+ */
+void evaluateCutConstant(cutNode& node)
+{
+    if (node.type != cutNode_term)  return;
+
+    TString key = getCutNodeKey(node);
+    if (key.IsFloat()) {
+        node.type = (std::atof(key.Data()) != 0) ? cutNode_true : cutNode_false;
+    }
+}
+
+/*
+ * node that remains from a logical expression : the value of a logical expression is 0 or 1,
+ * so a term that is not a comparison is written as "(w) != 0"
+ */
+cutNode getCutOperand(const cutNode& node)
+{
+    cutNode operand = node;
+    if (operand.type == cutNode_term && !isBooleanTerm(operand.text)) {
+        operand.text = Form("(%s) != 0", operand.text.Data());
+    }
+    return operand;
+}
+
+/*
+ * key to compare nodes : whitespace is removed from terms, children of "&&" and "||" are sorted
+ */
+TString getCutNodeKey(const cutNode& node)
+{
+    if (node.type == cutNode_true)   return "1";
+    if (node.type == cutNode_false)  return "0";
+    if (node.type == cutNode_term) {
+        TString key = node.text;
+        key.ReplaceAll(" ", "");
+        key.ReplaceAll("\t", "");
+        return key;
+    }
+    if (node.type == cutNode_not)  return "!(" + getCutNodeKey(node.children[0]) + ")";
+
+    std::vector<TString> keys;
+    for (unsigned i = 0; i < node.children.size(); ++i)  keys.push_back(getCutNodeKey(node.children[i]));
+    std::sort(keys.begin(), keys.end());
+
+    TString key = (node.type == cutNode_and) ? "&(" : "|(";
+    for (unsigned i = 0; i < keys.size(); ++i) {
+        if (i > 0)  key += ",";
+        key += keys[i];
+    }
+    return key + ")";
+}
+
+TString cutNodeToString(const cutNode& node)
+{
+    if (node.type == cutNode_true)   return "1";
+    if (node.type == cutNode_false)  return "0";
+    if (node.type == cutNode_term)   return node.text;
+    if (node.type == cutNode_not)    return "!(" + cutNodeToString(node.children[0]) + ")";
+
+    const char* op = (node.type == cutNode_and) ? " && " : " || ";
+    TString str = "";
+    for (unsigned i = 0; i < node.children.size(); ++i) {
+        if (i > 0)  str += op;
+        // "&&" has higher precedence than "||"
+        bool parentheses = (node.type == cutNode_and && node.children[i].type == cutNode_or);
+        if (parentheses)  str += "(" + cutNodeToString(node.children[i]) + ")";
+        else              str += cutNodeToString(node.children[i]);
+    }
+    return str;
+}
+
+/*
+ * positions of the logical operators "&&" (op = '&') or "||" (op = '|') that are not inside parentheses or brackets
+ */
+std::vector<int> findTopLevelOperators(const TString& text, char op)
+{
+    std::vector<int> positions;
+    int depth = 0;
+    for (int i = 0; i < text.Length(); ++i) {
+        char c = text[i];
+        if (c == '(' || c == '[')  depth++;
+        else if (c == ')' || c == ']')  depth--;
+        else if (depth == 0 && c == op && i+1 < text.Length() && text[i+1] == op) {
+            positions.push_back(i);
+            ++i;
+        }
+    }
+    return positions;
+}
+
+/*
+ * true if "text" is "(...)" where the first parenthesis is closed by the last character
+ */
+bool isEnclosedInParentheses(const TString& text)
+{
+    if (text.Length() < 2 || text[0] != '(' || text[text.Length() - 1] != ')')  return false;
+
+    int depth = 0;
+    for (int i = 0; i < text.Length(); ++i) {
+        if (text[i] == '(')  depth++;
+        else if (text[i] == ')')  depth--;
+        if (depth == 0 && i < text.Length() - 1)  return false;
+    }
+    return true;
+}
+
+/*
+ * true if the value of the term is 0 or 1 : a comparison or a negation at the top level
+ */
+bool isBooleanTerm(const TString& text)
+{
+    if (text.Length() > 0 && text[0] == '!')  return true;
+
+    int depth = 0;
+    for (int i = 0; i < text.Length(); ++i) {
+        char c = text[i];
+        if (c == '(' || c == '[')  depth++;
+        else if (c == ')' || c == ']')  depth--;
+        else if (depth == 0 && (c == '<' || c == '>' || (c == '=' && i+1 < text.Length() && text[i+1] == '=') ||
+                                (c == '!' && i+1 < text.Length() && text[i+1] == '=')))  return true;
+    }
+    return false;
+}
+
+/*
+ * true if "text" has "&&" or "||" that are not inside parentheses or brackets
+ */
+bool isLogicalExpression(const TString& text)
+{
+    return !findTopLevelOperators(text, '&').empty() || !findTopLevelOperators(text, '|').empty();
+}
+
+/*
+ * true if "text" is a list of arguments, e.g. "A && B, C" of "Alt$(A && B, C)"
+ */
+bool hasTopLevelComma(const TString& text)
+{
+    int depth = 0;
+    for (int i = 0; i < text.Length(); ++i) {
+        char c = text[i];
+        if (c == '(' || c == '[')  depth++;
+        else if (c == ')' || c == ']')  depth--;
+        else if (depth == 0 && c == ',')  return true;
+    }
+    return false;
+}
+
+/*
+ * simplify the selections inside the parentheses of a term, e.g. "Max$(pt*(A && A))" becomes "Max$(pt*((A) != 0))".
+ * Argument lists, e.g. "Alt$(A && B, C)", are not parsed as selections. The simplified selection replaces the group
+ * only if its value is still 0 or 1.
+ */
+TString simplifyCutGroups(TString text)
+{
+    TString result = "";
+    int i = 0;
+    while (i < text.Length()) {
+        if (text[i] != '(') {
+            result += text[i];
+            ++i;
+            continue;
+        }
+
+        // find the closing parenthesis
+        int depth = 0;
+        int j = i;
+        for (; j < text.Length(); ++j) {
+            if (text[j] == '(')  depth++;
+            else if (text[j] == ')')  depth--;
+            if (depth == 0)  break;
+        }
+        if (j >= text.Length()) {
+            // parentheses do not match, the rest is not changed
+            result += text(i, text.Length() - i);
+            break;
+        }
+
+        TString inner = text(i + 1, j - i - 1);
+        if (isLogicalExpression(inner) && !hasTopLevelComma(inner)) {
+            CutExpression cut(inner.Data());
+            cut.simplify();
+            TString simplified = cut.toString();
+            if (simplified == "0" || simplified == "1" || isBooleanTerm(simplified) || isLogicalExpression(simplified)) {
+                inner = simplified;
+            }
+        }
+        else {
+            inner = simplifyCutGroups(inner);
+        }
+        result += "(" + inner + ")";
+        i = j + 1;
+    }
+    return result;
+}
+
+#endif /* CUTEXPRESSION_H_ */
@@ -0,0 +1,251 @@
+/*
+ * CutFlow.h
+ *
+ * class to count events and objects passing a sequence of cumulative selection stages.
+ * Counts are kept at event and photon level, both unweighted and weighted.
+ * CutFlow objects filled by different threads or jobs can be merged with merge().
+ */
+
+#ifndef CUTFLOW_H_
+#define CUTFLOW_H_
+
+#include <TString.h>
+#include <TH1D.h>
+#include <TDirectory.h>
+#include <TMath.h>
+
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+enum cutFlowLevel {
+    cutFlow_event,
+    cutFlow_photon,
+    nCutFlowLevels
+};
+const char* const cutFlowLevelNames[nCutFlowLevels] = {"events", "photons"};
+
+class CutFlow {
+public:
+    CutFlow(int nStages, const char* const stageNames[], const char* name = "cutFlow");
+    virtual ~CutFlow();
+
+    void     fill(int level, int stage, double weight = 1, Long64_t n = 1);
+    void     merge(const CutFlow* other);
+    void     reset();
+
+    int      getNStages() const;
+    Long64_t getCount(int level, int stage) const;
+    double   getWeightedCount(int level, int stage) const;
+    double   getEfficiency(int level, int stage, bool weighted = true) const;
+    double   getRelativeEfficiency(int level, int stage, bool weighted = true) const;
+
+    void     print() const;
+    void     write(TDirectory* dir) const;
+    void     saveState(TDirectory* dir) const;
+    bool     loadState(TDirectory* dir);
+
+private:
+    TString name;
+    std::vector<TString>  stageNames;
+    std::vector<Long64_t> counts[nCutFlowLevels];
+    std::vector<double>   sumw[nCutFlowLevels];     // sum of weights
+    std::vector<double>   sumw2[nCutFlowLevels];    // sum of squares of weights
+};
+
+CutFlow::CutFlow(int nStages, const char* const stageNames[], const char* name)
+{
+    this->name = name;
+    for (int i = 0; i < nStages; ++i) {
+        this->stageNames.push_back(stageNames[i]);
+    }
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        counts[l].assign(nStages, 0);
+        sumw[l].assign(nStages, 0);
+        sumw2[l].assign(nStages, 0);
+    }
+}
+
+CutFlow::~CutFlow()
+{
+}
+
+/*
+ * count "n" entries with weight "weight" for "stage"
+ */
+void CutFlow::fill(int level, int stage, double weight, Long64_t n)
+{
+    counts[level][stage] += n;
+    sumw[level][stage]  += n * weight;
+    sumw2[level][stage] += n * weight * weight;
+}
+
+/*
+ * add the counts of "other" to this object. "other" must have the same stages.
+ */
+void CutFlow::merge(const CutFlow* other)
+{
+    if (other->getNStages() != getNStages()) {
+        std::cout << "CutFlow::merge : " << other->name.Data() << " has " << other->getNStages() << " stages, "
+                  << name.Data() << " has " << getNStages() << " stages. Cut flows are not merged." << std::endl;
+        return;
+    }
+
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        for (int i = 0; i < getNStages(); ++i) {
+            counts[l][i] += other->counts[l][i];
+            sumw[l][i]   += other->sumw[l][i];
+            sumw2[l][i]  += other->sumw2[l][i];
+        }
+    }
+}
+
+void CutFlow::reset()
+{
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        counts[l].assign(getNStages(), 0);
+        sumw[l].assign(getNStages(), 0);
+        sumw2[l].assign(getNStages(), 0);
+    }
+}
+
+int CutFlow::getNStages() const
+{
+    return stageNames.size();
+}
+
+Long64_t CutFlow::getCount(int level, int stage) const
+{
+    return counts[level][stage];
+}
+
+double CutFlow::getWeightedCount(int level, int stage) const
+{
+    return sumw[level][stage];
+}
+
+/*
+ * fraction of the entries of the first stage that pass "stage"
+ */
+double CutFlow::getEfficiency(int level, int stage, bool weighted) const
+{
+    double n0 = weighted ? sumw[level][0]     : counts[level][0];
+    double n  = weighted ? sumw[level][stage] : counts[level][stage];
+
+    return (n0 != 0) ? n / n0 : 0;
+}
+
+/*
+ * fraction of the entries of the previous stage that pass "stage"
+ */
+double CutFlow::getRelativeEfficiency(int level, int stage, bool weighted) const
+{
+    if (stage == 0)  return 1;
+
+    double nPrev = weighted ? sumw[level][stage-1] : counts[level][stage-1];
+    double n     = weighted ? sumw[level][stage]   : counts[level][stage];
+
+    return (nPrev != 0) ? n / nPrev : 0;
+}
+
+void CutFlow::print() const
+{
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        std::cout << name.Data() << " : " << cutFlowLevelNames[l] << std::endl;
+        std::cout << std::left << std::setw(16) << "stage" << std::right << std::setw(14) << "count"
+                  << std::setw(16) << "weighted" << std::setw(12) << "eff" << std::setw(12) << "rel. eff" << std::endl;
+        for (int i = 0; i < getNStages(); ++i) {
+            std::cout << std::left << std::setw(16) << stageNames[i].Data() << std::right
+                      << std::setw(14) << counts[l][i]
+                      << std::setw(16) << std::setprecision(6) << sumw[l][i]
+                      << std::setw(12) << std::setprecision(4) << getEfficiency(l, i)
+                      << std::setw(12) << getRelativeEfficiency(l, i) << std::endl;
+        }
+    }
+    std::cout << std::setprecision(6);
+}
+
+/*
+ * write the cut flow into "dir" as histograms whose bins are labeled by stage name.
+ * For each level there is a weighted histogram, with errors sqrt(sum of weights^2), and an unweighted one.
+ */
+void CutFlow::write(TDirectory* dir) const
+{
+    dir->cd();
+
+    const int nStages = getNStages();
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        TH1D* hWeighted   = new TH1D(Form("%s_%s", name.Data(), cutFlowLevelNames[l]),
+                                     Form("cut flow : %s;;weighted %s", cutFlowLevelNames[l], cutFlowLevelNames[l]), nStages, 0, nStages);
+        TH1D* hUnweighted = new TH1D(Form("%s_%s_unweighted", name.Data(), cutFlowLevelNames[l]),
+                                     Form("cut flow : %s;;%s", cutFlowLevelNames[l], cutFlowLevelNames[l]), nStages, 0, nStages);
+        for (int i = 0; i < nStages; ++i) {
+            hWeighted->GetXaxis()->SetBinLabel(i+1, stageNames[i].Data());
+            hUnweighted->GetXaxis()->SetBinLabel(i+1, stageNames[i].Data());
+            hWeighted->SetBinContent(i+1, sumw[l][i]);
+            hWeighted->SetBinError(i+1, TMath::Sqrt(sumw2[l][i]));
+            hUnweighted->SetBinContent(i+1, counts[l][i]);
+        }
+        hWeighted->Write();
+        hUnweighted->Write();
+    }
+}
+
+/*
+ * write the counts into "dir" as they are, so that loadState() restores them exactly, e.g. for checkpoints of an event loop.
+ * Use write() for the output of an analysis.
+ */
+void CutFlow::saveState(TDirectory* dir) const
+{
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        dir->WriteObject(&counts[l], Form("%s_%s_counts", name.Data(), cutFlowLevelNames[l]));
+        dir->WriteObject(&sumw[l],   Form("%s_%s_sumw", name.Data(), cutFlowLevelNames[l]));
+        dir->WriteObject(&sumw2[l],  Form("%s_%s_sumw2", name.Data(), cutFlowLevelNames[l]));
+    }
+}
+
+/*
+ * replace the counts by the ones written by saveState() into "dir".
+ * Returns false and keeps the counts if "dir" does not have the counts of a cut flow with the same stages.
+ */
+bool CutFlow::loadState(TDirectory* dir)
+{
+    std::vector<Long64_t>* savedCounts[nCutFlowLevels];
+    std::vector<double>*   savedSumw[nCutFlowLevels];
+    std::vector<double>*   savedSumw2[nCutFlowLevels];
+
+    bool found = true;
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        savedCounts[l] = NULL;
+        savedSumw[l] = NULL;
+        savedSumw2[l] = NULL;
+        dir->GetObject(Form("%s_%s_counts", name.Data(), cutFlowLevelNames[l]), savedCounts[l]);
+        dir->GetObject(Form("%s_%s_sumw", name.Data(), cutFlowLevelNames[l]), savedSumw[l]);
+        dir->GetObject(Form("%s_%s_sumw2", name.Data(), cutFlowLevelNames[l]), savedSumw2[l]);
+
+        found = found && savedCounts[l] != NULL && savedSumw[l] != NULL && savedSumw2[l] != NULL &&
+                (int)savedCounts[l]->size() == getNStages() && (int)savedSumw[l]->size() == getNStages() &&
+                (int)savedSumw2[l]->size() == getNStages();
+    }
+
+    if (found) {
+        for (int l = 0; l < nCutFlowLevels; ++l) {
+            counts[l] = *savedCounts[l];
+            sumw[l]   = *savedSumw[l];
+            sumw2[l]  = *savedSumw2[l];
+        }
+    }
+    else {
+        std::cout << "CutFlow::loadState : " << dir->GetName() << " has no counts of " << name.Data() << " with "
+                  << getNStages() << " stages. Counts are not changed." << std::endl;
+    }
+
+    for (int l = 0; l < nCutFlowLevels; ++l) {
+        delete savedCounts[l];
+        delete savedSumw[l];
+        delete savedSumw2[l];
+    }
+    return found;
+}
+
+#endif /* CUTFLOW_H_ */
@@ -0,0 +1,327 @@
+/*
+ * DrawPlan.h
+ *
+ * class to collect draws of a tree and fill all of them in a single pass over the tree.
+ * The draw functions of a plan are the same as the ones in treeUtil.h, but they only register the draw.
+ * execute() reads the tree once and fills every registered histogram.
+ *
+ * Whole expressions are shared between the draws of a plan :
+ *  - every distinct expression is compiled once and evaluated once per entry, whichever draws use it
+ *  - a selection is simplified and split at its top level "&&" (see CutExpression.h), so that a term that is in several
+ *    selections, e.g. the "formula == Max$(...)" term of the draws of the leading object, is evaluated only once.
+ *    Tautologies like "1" and duplicate terms are dropped.
+ * Parts of an expression are not shared : e.g. the "Max$(...)" of drawMaximum() is computed once by its formula and again
+ * for every element by its selection "formula == Max$(...)", as in TTree::Draw(). The cost of such a draw is still
+ * O(n^2) per entry for n elements.
+ *
+ * A draw of a plan gives the same histogram as the corresponding draw of treeUtil.h, with one difference :
+ * if a draw has arrays of different lengths, only the first elements up to the shortest length are filled.
+ * As in TTree::Draw(), the value of the selection is a weight only if the selection given to the plan is a single term,
+ * e.g. "w", the selection "1 && w" is 0 or 1.
+ * The plan works for any tree, friends of the tree can be used in the expressions.
+ *
+ * usage :
+ *  DrawPlan plan(tree);
+ *  plan.drawMaximum("pt", "abs(eta) < 1.44", hPt);
+ *  plan.drawMaximumGeneral("eta", "pt", "abs(eta) < 1.44", hEta);
+ *  plan.execute();
+ */
+
+#ifndef DRAWPLAN_H_
+#define DRAWPLAN_H_
+
+#include <TTree.h>
+#include <TTreeFormula.h>
+#include <TH1.h>
+#include <TString.h>
+#include <TMath.h>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+
+#include "treeUtil.h"
+#include "CutExpression.h"
+
+class DrawPlan {
+public:
+    DrawPlan(TTree* tree);
+    virtual ~DrawPlan();
+
+    void draw(TString varexp, TString selection, TH1* hist);
+    void drawMaximum(TString formula, TString condition = "1", TH1* hist = NULL, bool plotZero = false);
+    void drawMaximum(TString formula, TString condition = "1", TString cut = "1", TH1* hist = NULL, bool plotZero = false);
+    void drawMaximumGeneral   (TString formula, TString formulaForMax, TString conditionForMax = "1", TH1* hist = NULL);
+    void drawMaximumGeneral   (TString formula, TString formulaForMax, TString conditionForMax = "1", TString cut = "1", TH1* hist = NULL);
+    void drawMaximum2nd(TString formula, TString condition = "1", TH1* hist = NULL, bool plotZero = false);
+    void drawMaximum2nd(TString formula, TString condition = "1", TString cut = "1", TH1* hist = NULL, bool plotZero = false);
+    void drawMaximum2ndGeneral(TString formula, TString formulaForMax, TString conditionForMax = "1", TH1* hist = NULL);
+    void drawMaximum2ndGeneral(TString formula, TString formulaForMax, TString conditionForMax = "1", TString cut = "1", TH1* hist = NULL);
+
+    Long64_t execute(Long64_t nEntries = -1, Long64_t firstEntry = 0);
+    void     clear();
+    int      getNDraws() const;
+    int      getNExpressions() const;
+
+private:
+    // a compiled expression and its values for the current entry
+    struct planExpression {
+        TTreeFormula* formula;
+        bool multiple;                  // expression has more than one element per entry
+        int  nData;                     // number of elements for the current entry
+        std::vector<Double_t> values;
+    };
+    // a registered draw : "var" is filled for the elements where every term of the selection is nonzero
+    struct planDraw {
+        TH1* hist;
+        int  var;
+        std::vector<int> terms;
+        bool weighted;                  // the selection is a single term whose value is the weight
+    };
+
+    int  addExpression(TString expression);
+    void evaluate(planExpression& expression);
+
+    TTree* tree;
+    std::vector<planExpression> expressions;
+    std::map<std::string, int>  expressionIndex;    // index in "expressions" of each distinct expression
+    std::vector<planDraw> draws;
+
+    // the plan owns its formulas, it is not copied
+    DrawPlan(const DrawPlan&);
+    DrawPlan& operator=(const DrawPlan&);
+};
+
+DrawPlan::DrawPlan(TTree* tree)
+{
+    this->tree = tree;
+}
+
+DrawPlan::~DrawPlan()
+{
+    clear();
+}
+
+/*
+ * register a draw of "varexp" for the elements that pass "selection", same as tree->Draw("varexp >> hist", selection).
+ * The histogram must be supplied, it is reset when the plan is executed.
+ */
+void DrawPlan::draw(TString varexp, TString selection, TH1* hist)
+{
+    if (hist == NULL) {
+        std::cout << "DrawPlan : no histogram is supplied for " << varexp.Data() << ", draw is not added." << std::endl;
+        return;
+    }
+
+    planDraw draw;
+    draw.hist = hist;
+    draw.var = addExpression(varexp);
+
+    CutExpression cut(selection.Data());
+    draw.weighted = cut.isTerm();
+    cut.simplify();
+    std::vector<TString> terms = cut.getTerms();
+    for (unsigned i = 0; i < terms.size(); ++i) {
+        int term = addExpression(terms[i]);
+        if (term < 0)  draw.var = -1;
+        draw.terms.push_back(term);
+    }
+    // the draw is not valid if one of its expressions is not valid
+    if (draw.var < 0)  return;
+
+    draws.push_back(draw);
+}
+
+/*
+ * same as drawMaximum() in treeUtil.h
+ */
+void DrawPlan::drawMaximum(TString formula, TString condition, TH1* hist, bool plotZero)
+{
+    if (plotZero)  draw(getMaximumFormula(formula, condition), "1", hist);
+    else           draw(getMaximumFormula(formula, condition), getMaximumSelection(formula, condition), hist);
+}
+
+void DrawPlan::drawMaximum(TString formula, TString condition, TString cut, TH1* hist, bool plotZero)
+{
+    if (plotZero)  draw(getMaximumFormula(formula, condition), cut, hist);
+    else           draw(getMaximumFormula(formula, condition), mergeCuts(getMaximumSelection(formula, condition), cut), hist);
+}
+
+/*
+ * same as drawMaximumGeneral() in treeUtil.h
+ */
+void DrawPlan::drawMaximumGeneral(TString formula, TString formulaForMax, TString conditionForMax, TH1* hist)
+{
+    draw(formula, getMaximumSelection(formulaForMax, conditionForMax), hist);
+}
+
+void DrawPlan::drawMaximumGeneral(TString formula, TString formulaForMax, TString conditionForMax, TString cut, TH1* hist)
+{
+    draw(formula, mergeCuts(getMaximumSelection(formulaForMax, conditionForMax), cut), hist);
+}
+
+/*
+ * same as drawMaximum2nd() in treeUtil.h
+ */
+void DrawPlan::drawMaximum2nd(TString formula, TString condition, TH1* hist, bool plotZero)
+{
+    if (plotZero)  draw(getMaximum2ndFormula(formula, condition), "1", hist);
+    else           drawMaximum2ndGeneral(formula, formula, condition, hist);
+}
+
+void DrawPlan::drawMaximum2nd(TString formula, TString condition, TString cut, TH1* hist, bool plotZero)
+{
+    if (plotZero)  draw(getMaximum2ndFormula(formula, condition), cut, hist);
+    else           drawMaximum2ndGeneral(formula, formula, condition, cut, hist);
+}
+
+/*
+ * same as drawMaximum2ndGeneral() in treeUtil.h
+ */
+void DrawPlan::drawMaximum2ndGeneral(TString formula, TString formulaForMax, TString conditionForMax, TH1* hist)
+{
+    draw(formula, getMaximum2ndSelection(formulaForMax, conditionForMax), hist);
+}
+
+void DrawPlan::drawMaximum2ndGeneral(TString formula, TString formulaForMax, TString conditionForMax, TString cut, TH1* hist)
+{
+    draw(formula, mergeCuts(getMaximum2ndSelection(formulaForMax, conditionForMax), cut), hist);
+}
+
+/*
+ * fill the histograms of every registered draw in a single pass over the entries of the tree.
+ * nEntries = -1 means all entries starting from "firstEntry". returns the number of entries read.
+ * The draws stay registered, so the plan can be executed again, e.g. on another range of entries.
+ */
+Long64_t DrawPlan::execute(Long64_t nEntries, Long64_t firstEntry)
+{
+    for (unsigned d = 0; d < draws.size(); ++d) {
+        draws[d].hist->Reset();
+    }
+    if (draws.empty())  return 0;
+
+    const Double_t treeWeight = tree->GetWeight();
+    Long64_t entries = tree->GetEntries();
+    Long64_t lastEntry = (nEntries < 0) ? entries : TMath::Min(entries, firstEntry + nEntries);
+
+    Long64_t nRead = 0;
+    int treeNumber = -1;
+    for (Long64_t j = firstEntry; j < lastEntry; ++j)
+    {
+        if (tree->LoadTree(j) < 0)  break;
+        if (tree->GetTreeNumber() != treeNumber) {
+            // next tree of a chain
+            treeNumber = tree->GetTreeNumber();
+            for (unsigned e = 0; e < expressions.size(); ++e) {
+                expressions[e].formula->UpdateFormulaLeaves();
+            }
+        }
+        nRead++;
+
+        // every distinct expression is evaluated once for this entry
+        for (unsigned e = 0; e < expressions.size(); ++e) {
+            evaluate(expressions[e]);
+        }
+
+        for (unsigned d = 0; d < draws.size(); ++d)
+        {
+            const planDraw& draw = draws[d];
+            const planExpression& var = expressions[draw.var];
+
+            // number of elements : the shortest array of the draw, 1 if every expression is a single value
+            int nData = var.multiple ? var.nData : -1;
+            for (unsigned t = 0; t < draw.terms.size(); ++t) {
+                const planExpression& term = expressions[draw.terms[t]];
+                if (term.multiple)  nData = (nData < 0) ? term.nData : TMath::Min(nData, term.nData);
+            }
+            if (nData < 0)  nData = TMath::Min(var.nData, 1);
+
+            for (int i = 0; i < nData; ++i)
+            {
+                // a selection that is a single term is used as weight, same as TTree::Draw()
+                Double_t weight = 1;
+                for (unsigned t = 0; t < draw.terms.size() && weight != 0; ++t) {
+                    const planExpression& term = expressions[draw.terms[t]];
+                    Double_t value = (term.nData > 0) ? term.values[term.multiple ? i : 0] : 0;
+                    weight = (draw.weighted) ? value : (weight != 0 && value != 0);
+                }
+                if (weight == 0)  continue;
+
+                draw.hist->Fill(var.values[var.multiple ? i : 0], treeWeight * weight);
+            }
+        }
+    }
+    return nRead;
+}
+
+/*
+ * remove every draw and delete the compiled expressions
+ */
+void DrawPlan::clear()
+{
+    for (unsigned e = 0; e < expressions.size(); ++e) {
+        delete expressions[e].formula;
+    }
+    expressions.clear();
+    expressionIndex.clear();
+    draws.clear();
+}
+
+int DrawPlan::getNDraws() const
+{
+    return draws.size();
+}
+
+/*
+ * number of distinct expressions evaluated per entry
+ */
+int DrawPlan::getNExpressions() const
+{
+    return expressions.size();
+}
+
+/*
+ * index of "expression" in "expressions", the expression is compiled if it is not there yet.
+ * returns -1 if the expression is not valid.
+ */
+int DrawPlan::addExpression(TString expression)
+{
+    std::string key = expression.Data();
+    std::map<std::string, int>::iterator it = expressionIndex.find(key);
+    if (it != expressionIndex.end())  return it->second;
+
+    TTreeFormula* formula = new TTreeFormula(Form("planExpression%d", (int)expressions.size()), expression.Data(), tree);
+    if (formula->GetNdim() == 0) {
+        std::cout << "DrawPlan : expression is not valid for tree " << tree->GetName() << " : " << expression.Data() << std::endl;
+        delete formula;
+        return -1;
+    }
+
+    planExpression planExp;
+    planExp.formula = formula;
+    planExp.multiple = (formula->GetMultiplicity() != 0);
+    planExp.nData = 0;
+    expressions.push_back(planExp);
+
+    int index = expressions.size() - 1;
+    expressionIndex[key] = index;
+    return index;
+}
+
+/*
+ * evaluate every element of "expression" for the current entry of the tree
+ */
+void DrawPlan::evaluate(planExpression& expression)
+{
+    // kTRUE loads the branches of the sizes of variable length arrays, same as drawCached() in treeUtil.h
+    expression.nData = expression.formula->GetManager()->GetNdata(kTRUE);
+    if ((int)expression.values.size() < expression.nData)  expression.values.resize(expression.nData);
+
+    // element 0 is evaluated first, it loads the branches of the expression for this entry
+    for (int i = 0; i < expression.nData; ++i) {
+        expression.values[i] = expression.formula->EvalInstance(i);
+    }
+}
+
+#endif /* DRAWPLAN_H_ */
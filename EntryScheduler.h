@@ -0,0 +1,275 @@
+/*
+ * EntryScheduler.h
+ *
+ * class to hand out chunks of the entries of a set of friend trees to the threads of a parallel event loop.
+ *
+ * Chunks are made of whole clusters, a cluster being a range of entries whose baskets start and end at the same entries
+ * in every tree of the set (the common cluster boundaries of the trees). So the baskets of a chunk are read and
+ * decompressed by one thread only. If the trees have too few common boundaries, the boundaries of the first tree are used,
+ * see the constructor.
+ *
+ * The cost of an event varies a lot, e.g. with the number of photons and jets in PbPb, so equal ranges of entries do not
+ * take equal time. Every thread has its own queue of clusters, a contiguous range that it takes from the front.
+ * A thread whose queue is empty steals the back half of the queue that has the most entries left (work stealing).
+ * The size of a chunk adapts to the measured cost : each thread measures the time per entry of its previous chunks and
+ * takes chunks of about "targetChunkTime" seconds, but at most half of its queue, so that the end of the job can be balanced.
+ *
+ * usage :
+ *  TTree* trees[2] = {evtTree, photonTree};
+ *  EntryScheduler scheduler(2, trees, 0, evtTree->GetEntries(), nThreads);
+ *  // in thread "t"
+ *  Long64_t first, last;
+ *  while (scheduler.next(t, &first, &last)) {
+ *      for (Long64_t j = first; j < last; ++j) {...}
+ *  }
+ */
+
+#ifndef ENTRYSCHEDULER_H_
+#define ENTRYSCHEDULER_H_
+
+#include <TTree.h>
+#include <TMath.h>
+
+#include <vector>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+class EntryScheduler {
+public:
+    EntryScheduler(int nTrees, TTree* const trees[], Long64_t firstEntry, Long64_t lastEntry, int nWorkers, double targetChunkTime = 0.05);
+    virtual ~EntryScheduler();
+
+    bool     next(int worker, Long64_t* first, Long64_t* last);
+    int      getNWorkers() const;
+    int      getNClusters() const;
+    Long64_t getClusterStart(int cluster) const;
+    int      getNChunks() const;
+    int      getNSteals() const;
+    double   getCostPerEntry(int worker) const;
+
+private:
+    // queue of a worker : clusters [begin, end) that are not handed out yet
+    struct workerQueue {
+        std::mutex mutex;
+        int begin;
+        int end;
+        double   costPerEntry;      // measured time per entry in seconds, < 0 if nothing is measured yet
+        Long64_t chunkEntries;      // entries of the chunk being processed, 0 if none
+        std::chrono::steady_clock::time_point chunkStart;
+    };
+
+    Long64_t getEntries(int beginCluster, int endCluster) const;
+    bool     steal(int worker);
+
+    std::vector<Long64_t> boundaries;       // start of each cluster, followed by the last entry
+    std::vector<workerQueue*> queues;
+    double targetChunkTime;
+    std::atomic<int> nChunks;
+    std::atomic<int> nSteals;
+};
+
+/*
+ * schedule the entries [firstEntry, lastEntry) of "trees" for "nWorkers" threads.
+ * Chunks are aligned to the cluster boundaries common to every tree. If there are less than 2 common clusters per worker,
+ * e.g. if the trees were flushed by size and not by number of entries, chunks are aligned to the clusters of trees[0] only,
+ * and the baskets of the other trees at the edges of the chunks may be read by two threads.
+ */
+EntryScheduler::EntryScheduler(int nTrees, TTree* const trees[], Long64_t firstEntry, Long64_t lastEntry, int nWorkers, double targetChunkTime)
+{
+    this->targetChunkTime = targetChunkTime;
+    nChunks = 0;
+    nSteals = 0;
+    nWorkers = TMath::Max(nWorkers, 1);
+
+    // cluster boundaries of each tree within the range
+    std::vector<std::set<Long64_t> > treeBoundaries(nTrees);
+    for (int i = 0; i < nTrees; ++i) {
+        Long64_t entries = TMath::Min(trees[i]->GetEntries(), lastEntry);
+        TTree::TClusterIterator clusterIter = trees[i]->GetClusterIterator(firstEntry);
+        Long64_t start;
+        while ((start = clusterIter()) < entries) {
+            if (start > firstEntry)  treeBoundaries[i].insert(start);
+        }
+    }
+
+    std::set<Long64_t> common = (nTrees > 0) ? treeBoundaries[0] : std::set<Long64_t>();
+    for (int i = 1; i < nTrees; ++i) {
+        std::set<Long64_t> both;
+        for (std::set<Long64_t>::const_iterator it = common.begin(); it != common.end(); ++it) {
+            if (treeBoundaries[i].count(*it) > 0)  both.insert(*it);
+        }
+        common = both;
+    }
+    if (nTrees > 1 && (int)common.size() + 1 < 2 * nWorkers && common.size() < treeBoundaries[0].size()) {
+        std::cout << "EntryScheduler : the trees have only " << common.size() + 1 << " common clusters, "
+                  << "chunks are aligned to the clusters of " << trees[0]->GetName() << "." << std::endl;
+        common = treeBoundaries[0];
+    }
+
+    boundaries.push_back(firstEntry);
+    boundaries.insert(boundaries.end(), common.begin(), common.end());
+    boundaries.push_back(TMath::Max(lastEntry, firstEntry));
+
+    // every worker starts with a contiguous range of clusters with about the same number of entries
+    const Long64_t entries = boundaries.back() - firstEntry;
+    int cluster = 0;
+    for (int w = 0; w < nWorkers; ++w) {
+        workerQueue* queue = new workerQueue();
+        queue->begin = cluster;
+        Long64_t end = firstEntry + entries * (w + 1) / nWorkers;
+        while (cluster < getNClusters() && boundaries[cluster] < end)  cluster++;
+        queue->end = (w == nWorkers - 1) ? getNClusters() : cluster;
+        queue->costPerEntry = -1;
+        queue->chunkEntries = 0;
+        queues.push_back(queue);
+    }
+}
+
+EntryScheduler::~EntryScheduler()
+{
+    for (unsigned w = 0; w < queues.size(); ++w) {
+        delete queues[w];
+    }
+}
+
+/*
+ * next chunk of entries [first, last) for thread "worker", 0 <= worker < getNWorkers().
+ * Calling next() marks the previous chunk of the worker as done, its time is used to size the next chunk.
+ * returns false if every entry has been handed out.
+ */
+bool EntryScheduler::next(int worker, Long64_t* first, Long64_t* last)
+{
+    workerQueue* queue = queues[worker];
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    // only this worker changes its cost and its chunk, other workers change begin and end only
+    if (queue->chunkEntries > 0) {
+        double cost = std::chrono::duration<double>(now - queue->chunkStart).count() / queue->chunkEntries;
+        queue->costPerEntry = (queue->costPerEntry < 0) ? cost : 0.5 * (queue->costPerEntry + cost);
+        queue->chunkEntries = 0;
+    }
+
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (queue->begin < queue->end) {
+                // entries of about "targetChunkTime", at least one cluster and at most half of the queue
+                Long64_t target = (queue->costPerEntry > 0) ? (Long64_t)(targetChunkTime / queue->costPerEntry) : 0;
+                target = TMath::Min(target, getEntries(queue->begin, queue->end) / 2);
+
+                int end = queue->begin + 1;
+                while (end < queue->end && getEntries(queue->begin, end) < target)  end++;
+
+                *first = boundaries[queue->begin];
+                *last = boundaries[end];
+                queue->begin = end;
+                queue->chunkEntries = *last - *first;
+                queue->chunkStart = now;
+                nChunks++;
+                return true;
+            }
+        }
+        if (!steal(worker))  return false;
+    }
+}
+
+int EntryScheduler::getNWorkers() const
+{
+    return queues.size();
+}
+
+int EntryScheduler::getNClusters() const
+{
+    return boundaries.size() - 1;
+}
+
+/*
+ * first entry of "cluster", getClusterStart(getNClusters()) is the last entry of the range
+ */
+Long64_t EntryScheduler::getClusterStart(int cluster) const
+{
+    return boundaries[cluster];
+}
+
+/*
+ * number of chunks handed out so far
+ */
+int EntryScheduler::getNChunks() const
+{
+    return nChunks;
+}
+
+/*
+ * number of times a worker took clusters from the queue of another worker
+ */
+int EntryScheduler::getNSteals() const
+{
+    return nSteals;
+}
+
+/*
+ * time per entry in seconds measured by "worker", -1 if the worker has not finished a chunk yet
+ */
+double EntryScheduler::getCostPerEntry(int worker) const
+{
+    return queues[worker]->costPerEntry;
+}
+
+/*
+ * number of entries in clusters [beginCluster, endCluster)
+ */
+Long64_t EntryScheduler::getEntries(int beginCluster, int endCluster) const
+{
+    return boundaries[endCluster] - boundaries[beginCluster];
+}
+
+/*
+ * move the back half of the queue with the most entries left to the empty queue of "worker".
+ * returns false if no queue has clusters left.
+ */
+bool EntryScheduler::steal(int worker)
+{
+    while (true)
+    {
+        // the queue of the victim may change before it is locked again, then another victim is chosen
+        int victim = -1;
+        Long64_t maxEntries = 0;
+        for (int w = 0; w < getNWorkers(); ++w) {
+            if (w == worker)  continue;
+            workerQueue* queue = queues[w];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            Long64_t entries = (queue->begin < queue->end) ? getEntries(queue->begin, queue->end) : 0;
+            if (entries > maxEntries) {
+                maxEntries = entries;
+                victim = w;
+            }
+        }
+        if (victim < 0)  return false;
+
+        int begin;
+        int end;
+        {
+            workerQueue* queue = queues[victim];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (queue->begin >= queue->end)  continue;
+
+            // the owner keeps the front half, the last cluster of a queue is taken as a whole
+            int middle = queue->begin + (queue->end - queue->begin) / 2;
+            begin = middle;
+            end = queue->end;
+            queue->end = middle;
+        }
+
+        std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+        queues[worker]->begin = begin;
+        queues[worker]->end = end;
+        nSteals++;
+        return true;
+    }
+}
+
+#endif /* ENTRYSCHEDULER_H_ */
@@ -0,0 +1,352 @@
+/*
+ * EventIndex.h
+ *
+ * class to index the entries of "hiEvtAnalyzer/HiTree" by (run, lumi, evt).
+ *
+ * Merged datasets may have the same event more than once. The index is built in a single streaming pass over the
+ * run, lumi and evt branches, every entry is looked up in a hash set of the events seen so far, so duplicates are found
+ * while reading. The first entry of an event is kept, the later ones are flagged, see isDuplicate().
+ * The same hash set gives the entry of an event in constant time, e.g. to read a specific event for an event display.
+ *
+ * Memory is compact : the key of each entry (12 bytes), one bit per entry for the duplicate flag and a table of
+ * 4 byte slots (entry + 1, 0 if empty) with open addressing and linear probing, kept at most 2/3 full.
+ * Building the index does not change the branch addresses of the tree, so it can be built while the tree is bound to views.
+ *
+ * The index can be written to a file next to the HiForest file and read again, so that later jobs do not read the tree.
+ * An index is read only if it was built for the same file (same UUID) and the same number of entries.
+ *
+ * usage :
+ *  EventIndex* index = EventIndex::open(evtTree, "HiForest_eventIndex.root");
+ *  for (Long64_t j = 0; j < entries; ++j) {
+ *      if (index->isDuplicate(j))  continue;
+ *      ...
+ *  }
+ *  Long64_t entry = index->getEntry(run, lumi, evt);
+ */
+
+#ifndef EVENTINDEX_H_
+#define EVENTINDEX_H_
+
+#include <TTree.h>
+#include <TBranch.h>
+#include <TLeaf.h>
+#include <TFile.h>
+#include <TNamed.h>
+#include <TString.h>
+#include <TDirectory.h>
+#include <TUUID.h>
+#include <TSystem.h>
+
+#include <vector>
+#include <iostream>
+
+class EventIndex {
+public:
+    EventIndex();
+    virtual ~EventIndex();
+
+    Long64_t build(TTree* evtTree);
+    bool     read(const char* fileName, TTree* evtTree);
+    bool     write(const char* fileName, TTree* evtTree) const;
+    static EventIndex* open(TTree* evtTree, const char* fileName = NULL);
+    static TString getDefaultFileName(TTree* evtTree);
+
+    Long64_t getEntry(Int_t run, Int_t lumi, Int_t evt) const;
+    bool     isDuplicate(Long64_t entry) const;
+    bool     getEvent(Long64_t entry, Int_t* run, Int_t* lumi, Int_t* evt) const;
+    Long64_t getEntries() const;
+    Long64_t getNEvents() const;
+    Long64_t getNDuplicates() const;
+    size_t   getMemoryUsage() const;
+    static ULong64_t hash(Int_t run, Int_t lumi, Int_t evt);
+
+private:
+    static TString   getFileId(TTree* evtTree);
+    void     resetTable(Long64_t entries);
+    void     addEntry(Long64_t entry);
+
+    std::vector<Int_t> runs;        // key of each entry, index is the entry
+    std::vector<Int_t> lumis;
+    std::vector<Int_t> evts;
+    std::vector<bool>  duplicate;   // entry has the key of a previous entry
+    std::vector<UInt_t> slots;      // first entry + 1 of each key in the table, 0 if the slot is empty. size is a power of 2
+    Long64_t nDuplicates;
+};
+
+EventIndex::EventIndex()
+{
+    nDuplicates = 0;
+}
+
+EventIndex::~EventIndex()
+{
+}
+
+/*
+ * index every entry of "evtTree" by (run, lumi, evt). Only the three branches are read, their addresses are not changed.
+ * returns the number of duplicate entries, -1 if the tree does not have the branches.
+ */
+Long64_t EventIndex::build(TTree* evtTree)
+{
+    runs.clear();
+    lumis.clear();
+    evts.clear();
+    duplicate.clear();
+    slots.clear();
+    nDuplicates = 0;
+
+    const char* branchNames[3] = {"run", "lumi", "evt"};
+    TBranch* branches[3];
+    TLeaf*   leaves[3];
+    for (int i = 0; i < 3; ++i) {
+        branches[i] = evtTree->GetBranch(branchNames[i]);
+        leaves[i] = (branches[i] != NULL) ? branches[i]->GetLeaf(branchNames[i]) : NULL;
+        if (leaves[i] == NULL) {
+            std::cout << "EventIndex : " << evtTree->GetName() << " has no branch " << branchNames[i] << ", index is not built." << std::endl;
+            return -1;
+        }
+    }
+
+    const Long64_t entries = evtTree->GetEntries();
+    if (entries >= (Long64_t)kMaxUInt) {
+        std::cout << "EventIndex : " << evtTree->GetName() << " has too many entries, index is not built." << std::endl;
+        return -1;
+    }
+    runs.resize(entries);
+    lumis.resize(entries);
+    evts.resize(entries);
+    duplicate.resize(entries, false);
+    resetTable(entries);
+
+    for (Long64_t j = 0; j < entries; ++j)
+    {
+        for (int i = 0; i < 3; ++i)  branches[i]->GetEntry(j);
+        // the leaves may be unsigned, the key keeps their bits
+        runs[j]  = (Int_t)(Long64_t)leaves[0]->GetValue();
+        lumis[j] = (Int_t)(Long64_t)leaves[1]->GetValue();
+        evts[j]  = (Int_t)(Long64_t)leaves[2]->GetValue();
+        addEntry(j);
+    }
+    return nDuplicates;
+}
+
+/*
+ * read the index written by write() into "fileName".
+ * returns false and keeps the current index if the file does not have an index for the file and entries of "evtTree".
+ */
+bool EventIndex::read(const char* fileName, TTree* evtTree)
+{
+    TDirectory* currentDirectory = gDirectory;
+    TFile* file = TFile::Open(fileName, "READ");
+    currentDirectory->cd();
+    if (file == NULL || file->IsZombie()) {
+        delete file;
+        return false;
+    }
+
+    TNamed* fileId = NULL;
+    std::vector<Int_t>* savedRuns = NULL;
+    std::vector<Int_t>* savedLumis = NULL;
+    std::vector<Int_t>* savedEvts = NULL;
+    file->GetObject("eventIndex_file", fileId);
+    file->GetObject("eventIndex_run", savedRuns);
+    file->GetObject("eventIndex_lumi", savedLumis);
+    file->GetObject("eventIndex_evt", savedEvts);
+
+    const Long64_t entries = evtTree->GetEntries();
+    bool found = fileId != NULL && savedRuns != NULL && savedLumis != NULL && savedEvts != NULL &&
+                 getFileId(evtTree) == fileId->GetTitle() &&
+                 (Long64_t)savedRuns->size() == entries && (Long64_t)savedLumis->size() == entries && (Long64_t)savedEvts->size() == entries;
+    if (found) {
+        runs = *savedRuns;
+        lumis = *savedLumis;
+        evts = *savedEvts;
+        duplicate.assign(entries, false);
+        nDuplicates = 0;
+        resetTable(entries);
+        for (Long64_t j = 0; j < entries; ++j)  addEntry(j);
+    }
+    else {
+        std::cout << "EventIndex : " << fileName << " has no index for " << getFileId(evtTree) << ", it is not used." << std::endl;
+    }
+
+    delete fileId;
+    delete savedRuns;
+    delete savedLumis;
+    delete savedEvts;
+    file->Close();
+    delete file;
+    return found;
+}
+
+/*
+ * write the keys of the entries into "fileName", the table is built again by read().
+ * returns false if the file cannot be written, e.g. if the directory of the HiForest file is read-only.
+ */
+bool EventIndex::write(const char* fileName, TTree* evtTree) const
+{
+    TDirectory* currentDirectory = gDirectory;
+    TFile* file = TFile::Open(fileName, "RECREATE");
+    currentDirectory->cd();
+    if (file == NULL || file->IsZombie()) {
+        std::cout << "EventIndex : " << fileName << " cannot be created, index is not written." << std::endl;
+        delete file;
+        return false;
+    }
+
+    TNamed fileId("eventIndex_file", getFileId(evtTree).Data());
+    file->WriteTObject(&fileId);
+    file->WriteObject(&runs, "eventIndex_run");
+    file->WriteObject(&lumis, "eventIndex_lumi");
+    file->WriteObject(&evts, "eventIndex_evt");
+    file->Close();
+    delete file;
+    return true;
+}
+
+/*
+ * index of "evtTree" : read from "fileName" if it has an index of the tree, otherwise built and written into "fileName".
+ * fileName = NULL uses getDefaultFileName(). returns NULL if the index cannot be built.
+ */
+EventIndex* EventIndex::open(TTree* evtTree, const char* fileName)
+{
+    TString indexFileName = (fileName != NULL) ? fileName : getDefaultFileName(evtTree).Data();
+
+    EventIndex* index = new EventIndex();
+    if (!gSystem->AccessPathName(indexFileName.Data()) && index->read(indexFileName.Data(), evtTree))  return index;
+
+    if (index->build(evtTree) < 0) {
+        delete index;
+        return NULL;
+    }
+    index->write(indexFileName.Data(), evtTree);
+    return index;
+}
+
+/*
+ * file next to the file of "evtTree", e.g. "HiForest_eventIndex.root" for "HiForest.root"
+ */
+TString EventIndex::getDefaultFileName(TTree* evtTree)
+{
+    TString fileName = (evtTree->GetCurrentFile() != NULL) ? evtTree->GetCurrentFile()->GetName() : evtTree->GetName();
+    if (fileName.EndsWith(".root"))  fileName.Remove(fileName.Length() - 5);
+    return fileName + "_eventIndex.root";
+}
+
+/*
+ * UUID of the file of "evtTree" followed by the number of entries, identifies the tree an index was built for
+ */
+TString EventIndex::getFileId(TTree* evtTree)
+{
+    TString uuid = (evtTree->GetCurrentFile() != NULL) ? evtTree->GetCurrentFile()->GetUUID().AsString() : "";
+    return Form("%s:%lld", uuid.Data(), evtTree->GetEntries());
+}
+
+/*
+ * first entry of the event (run, lumi, evt), -1 if there is no such event
+ */
+Long64_t EventIndex::getEntry(Int_t run, Int_t lumi, Int_t evt) const
+{
+    if (slots.empty())  return -1;
+
+    const size_t mask = slots.size() - 1;
+    for (size_t s = hash(run, lumi, evt) & mask; slots[s] != 0; s = (s + 1) & mask) {
+        Long64_t j = slots[s] - 1;
+        if (runs[j] == run && lumis[j] == lumi && evts[j] == evt)  return j;
+    }
+    return -1;
+}
+
+/*
+ * true if "entry" is an event of a previous entry
+ */
+bool EventIndex::isDuplicate(Long64_t entry) const
+{
+    return entry < (Long64_t)duplicate.size() && duplicate[entry];
+}
+
+/*
+ * (run, lumi, evt) of "entry" without reading the tree. returns false if the entry is not indexed.
+ */
+bool EventIndex::getEvent(Long64_t entry, Int_t* run, Int_t* lumi, Int_t* evt) const
+{
+    if (entry < 0 || entry >= getEntries())  return false;
+
+    *run = runs[entry];
+    *lumi = lumis[entry];
+    *evt = evts[entry];
+    return true;
+}
+
+Long64_t EventIndex::getEntries() const
+{
+    return runs.size();
+}
+
+/*
+ * number of distinct events
+ */
+Long64_t EventIndex::getNEvents() const
+{
+    return getEntries() - nDuplicates;
+}
+
+Long64_t EventIndex::getNDuplicates() const
+{
+    return nDuplicates;
+}
+
+/*
+ * memory used by the index in bytes
+ */
+size_t EventIndex::getMemoryUsage() const
+{
+    return runs.size() * 3 * sizeof(Int_t) + duplicate.size() / 8 + slots.size() * sizeof(UInt_t);
+}
+
+/*
+ * 64 bit mix of the key (finalizer of splitmix64), the low bits are used as slot.
+ * It identifies an event independently of its entry, e.g. to seed the bootstrap weights of the event, see PoissonBootstrap.h
+ */
+ULong64_t EventIndex::hash(Int_t run, Int_t lumi, Int_t evt)
+{
+    ULong64_t x = ((ULong64_t)(UInt_t)run << 32 | (UInt_t)evt) ^ ((ULong64_t)(UInt_t)lumi * 0x9E3779B97F4A7C15ULL);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * empty table for "entries" keys, at most 2/3 of the slots are used so that probe sequences stay short.
+ * The table is not resized while entries are added.
+ */
+void EventIndex::resetTable(Long64_t entries)
+{
+    size_t nSlots = 16;
+    while (nSlots < (size_t)(entries + entries / 2 + 1))  nSlots *= 2;
+    slots.assign(nSlots, 0);
+}
+
+/*
+ * add the key of "entry" to the table if it is not there yet, otherwise flag the entry as duplicate
+ */
+void EventIndex::addEntry(Long64_t entry)
+{
+    const Int_t run = runs[entry];
+    const Int_t lumi = lumis[entry];
+    const Int_t evt = evts[entry];
+
+    const size_t mask = slots.size() - 1;
+    size_t s = hash(run, lumi, evt) & mask;
+    for (; slots[s] != 0; s = (s + 1) & mask) {
+        Long64_t j = slots[s] - 1;
+        if (runs[j] == run && lumis[j] == lumi && evts[j] == evt) {
+            duplicate[entry] = true;
+            nDuplicates++;
+            return;
+        }
+    }
+    slots[s] = (UInt_t)(entry + 1);
+}
+
+#endif /* EVENTINDEX_H_ */
@@ -0,0 +1,374 @@
+/*
+ * EventViews.h
+ *
+ * struct-of-arrays views of the HiForest objects of an event : EventInfo, SkimFlags, PhotonCollection and JetCollection.
+ * A view binds its buffers to the branches of a tree once, then the same buffers are reused for every entry,
+ * there is no allocation per entry. Only the branches of the view are read by getEntry().
+ *
+ * Array buffers are sized from the maximum length of the array branches in the tree, see getMaximumLength(),
+ * so a view must be bound again if the tree is replaced by a tree with longer arrays, e.g. the next file of a chain.
+ * The recorded maximum can be wrong, e.g. in merged files. getEntry() reads the counter of the arrays first, and it does not
+ * read the arrays of an entry that has more elements than the buffers hold : the entry is reported and must be skipped.
+ *
+ * usage :
+ *  PhotonCollection photons;
+ *  photons.bind(photonTree);
+ *  for (Long64_t j = 0; j < entries; ++j) {
+ *      photons.getEntry(j);
+ *      for (int i = 0; i < photons.n; ++i)  ... photons.pt[i] ...
+ *  }
+ */
+
+#ifndef EVENTVIEWS_H_
+#define EVENTVIEWS_H_
+
+#include <TTree.h>
+#include <TBranch.h>
+#include <TLeaf.h>
+#include <TMath.h>
+#include <TString.h>
+
+#include <vector>
+#include <iostream>
+
+// centrality variables bound by EventInfo
+enum centralityType {
+    centrality_none,
+    centrality_hiBin,       // for HI events
+    centrality_hf4sum,      // for pA events, hf4sum = hiHFplusEta4 + hiHFminusEta4
+    centrality_all
+};
+
+int getMaximumLength(TTree* tree, const char* branchName);
+
+/*
+ * base class of the views : keeps the bound branches and the buffers allocated for them
+ */
+class TreeView {
+public:
+    TreeView();
+    virtual ~TreeView();
+
+    Int_t getEntry(Long64_t entry);
+    void  unbind();
+
+    TTree* tree;                        // tree the view is bound to, NULL if not bound
+    std::vector<TBranch*> branches;     // bound branches, in the order they are read
+
+protected:
+    bool     bindBranch(const char* name, void* address);
+    bool     bindCounter(const char* name, Int_t* address, int capacity);
+    Float_t* newFloatArray(int length);
+    UChar_t* newUCharArray(int length);
+
+private:
+    std::vector<Float_t*> floatArrays;
+    std::vector<UChar_t*> ucharArrays;
+    Int_t*   counter;           // counter of the array branches, the first bound branch. NULL if the view has no arrays
+    int      counterCapacity;   // length of the array buffers
+};
+
+/*
+ * event level variables from "hiEvtAnalyzer/HiTree".
+ * Centrality variables that are not bound are -1.
+ */
+class EventInfo : public TreeView {
+public:
+    EventInfo();
+    void  bind(TTree* evtTree, int centrality = centrality_all);
+    float hf4sum() const;
+
+    int     centrality;     // centrality variables that are bound, see centralityType
+    Int_t   run;
+    Int_t   evt;
+    Int_t   lumi;
+    Float_t vz;
+    Int_t   hiBin;
+    Float_t hiHFplusEta4;
+    Float_t hiHFminusEta4;
+};
+
+/*
+ * event selection flags from "skimanalysis/HltTree".
+ * The collision event selection is "pcollisionEventSelection" for HI events, "pPAcollisionEventSelectionPA" for pp or pA events.
+ */
+class SkimFlags : public TreeView {
+public:
+    SkimFlags();
+    void bind(TTree* skimTree, const char* collisionEventSelectionName);
+
+    TString collisionEventSelectionName;    // name of the bound collision event selection, empty if none is bound
+    Int_t   pHBHENoiseFilter;
+    Int_t   collisionEventSelection;
+};
+
+/*
+ * photons from "multiPhotonAnalyzer/photon"
+ */
+class PhotonCollection : public TreeView {
+public:
+    PhotonCollection();
+    void bind(TTree* photonTree);
+
+    int      capacity;      // length of the buffers
+    Int_t    n;
+    Float_t* pt;
+    Float_t* eta;
+    Float_t* phi;
+    Float_t* swissCrx;
+    Float_t* seedTime;
+    Float_t* sigmaIetaIeta;
+    Float_t* sigmaIphiIphi;
+    Float_t* ecalRecHitSumEtConeDR04;
+    Float_t* hcalTowerSumEtConeDR04;
+    Float_t* trkSumPtHollowConeDR04;
+    Float_t* hadronicOverEm;
+    UChar_t* stages;        // not bound to a branch : bit k is set if the photon passed selection stage k
+};
+
+/*
+ * jets from a jet tree, e.g. "akPu3PFJetAnalyzer/t"
+ */
+class JetCollection : public TreeView {
+public:
+    JetCollection();
+    void bind(TTree* jetTree);
+
+    int      capacity;      // length of the buffers
+    Int_t    n;
+    Float_t* pt;
+    Float_t* eta;
+    Float_t* phi;
+};
+
+/*
+ * maximum number of elements of branch "branchName" over the entries of "tree".
+ * For a variable length array this is the maximum value of its counter leaf, as recorded when the tree was written.
+ */
+int getMaximumLength(TTree* tree, const char* branchName)
+{
+    TLeaf* leaf = tree->GetLeaf(branchName);
+    if (leaf == NULL)  return 0;
+
+    TLeaf* leafCount = leaf->GetLeafCount();
+    int length = (leafCount != NULL) ? leafCount->GetMaximum() : 1;
+    return length * leaf->GetLenStatic();
+}
+
+TreeView::TreeView()
+{
+    tree = NULL;
+    counter = NULL;
+    counterCapacity = 0;
+}
+
+/*
+ * the buffers are freed, but the addresses of the branches are not reset as the tree may have been deleted already.
+ * call unbind() before if the tree will be read after the view is destroyed.
+ */
+TreeView::~TreeView()
+{
+    for (unsigned i = 0; i < floatArrays.size(); ++i)  delete [] floatArrays[i];
+    for (unsigned i = 0; i < ucharArrays.size(); ++i)  delete [] ucharArrays[i];
+}
+
+/*
+ * read the bound branches for "entry". returns the number of bytes read.
+ * returns -1 if the entry has more elements than the buffers hold. Its arrays are then not read and the counter is set to 0.
+ */
+Int_t TreeView::getEntry(Long64_t entry)
+{
+    Int_t bytes = 0;
+    for (unsigned i = 0; i < branches.size(); ++i) {
+        bytes += branches[i]->GetEntry(entry);
+
+        // the counter is read first, the arrays would be written past the end of the buffers
+        if (i == 0 && counter != NULL && (*counter < 0 || *counter > counterCapacity)) {
+            std::cout << "TreeView : entry " << entry << " of tree " << tree->GetName() << " has " << *counter
+                      << " elements, but the buffers hold " << counterCapacity << ". The entry is skipped." << std::endl;
+            *counter = 0;
+            return -1;
+        }
+    }
+    return bytes;
+}
+
+/*
+ * reset the addresses of the bound branches and free the buffers
+ */
+void TreeView::unbind()
+{
+    for (unsigned i = 0; i < branches.size(); ++i)  branches[i]->ResetAddress();
+    for (unsigned i = 0; i < floatArrays.size(); ++i)  delete [] floatArrays[i];
+    for (unsigned i = 0; i < ucharArrays.size(); ++i)  delete [] ucharArrays[i];
+
+    branches.clear();
+    floatArrays.clear();
+    ucharArrays.clear();
+    tree = NULL;
+    counter = NULL;
+    counterCapacity = 0;
+}
+
+bool TreeView::bindBranch(const char* name, void* address)
+{
+    TBranch* branch = NULL;
+    tree->SetBranchAddress(name, address, &branch);
+    if (branch == NULL) {
+        std::cout << "TreeView : branch " << name << " does not exist in tree " << tree->GetName() << std::endl;
+        return false;
+    }
+    branches.push_back(branch);
+    return true;
+}
+
+/*
+ * bind the counter of the array branches, whose buffers hold "capacity" elements. must be the first bound branch.
+ */
+bool TreeView::bindCounter(const char* name, Int_t* address, int capacity)
+{
+    if (!bindBranch(name, address))  return false;
+
+    counter = address;
+    counterCapacity = capacity;
+    return true;
+}
+
+Float_t* TreeView::newFloatArray(int length)
+{
+    Float_t* array = new Float_t[length];
+    floatArrays.push_back(array);
+    return array;
+}
+
+UChar_t* TreeView::newUCharArray(int length)
+{
+    UChar_t* array = new UChar_t[length];
+    ucharArrays.push_back(array);
+    return array;
+}
+
+EventInfo::EventInfo() :
+        centrality(centrality_none), run(0), evt(0), lumi(0), vz(0), hiBin(-1), hiHFplusEta4(-1), hiHFminusEta4(-1)
+{
+}
+
+/*
+ * bind the event variables and the centrality variables given by "centrality"
+ */
+void EventInfo::bind(TTree* evtTree, int centrality)
+{
+    if (tree != NULL)  unbind();
+    tree = evtTree;
+    this->centrality = centrality;
+
+    hiBin = -1;
+    hiHFplusEta4 = -1;
+    hiHFminusEta4 = -1;
+
+    bindBranch("run", &run);
+    bindBranch("evt", &evt);
+    bindBranch("lumi", &lumi);
+    bindBranch("vz", &vz);
+    if (centrality == centrality_hiBin || centrality == centrality_all) {
+        bindBranch("hiBin", &hiBin);
+    }
+    if (centrality == centrality_hf4sum || centrality == centrality_all) {
+        bindBranch("hiHFplusEta4", &hiHFplusEta4);
+        bindBranch("hiHFminusEta4", &hiHFminusEta4);
+    }
+}
+
+float EventInfo::hf4sum() const
+{
+    if (centrality != centrality_hf4sum && centrality != centrality_all)  return -1;
+
+    return hiHFplusEta4 + hiHFminusEta4;
+}
+
+SkimFlags::SkimFlags() :
+        collisionEventSelectionName(""), pHBHENoiseFilter(0), collisionEventSelection(0)
+{
+}
+
+/*
+ * bind the noise filter and the collision event selection "collisionEventSelectionName", NULL binds no collision event selection
+ */
+void SkimFlags::bind(TTree* skimTree, const char* collisionEventSelectionName)
+{
+    if (tree != NULL)  unbind();
+    tree = skimTree;
+
+    bindBranch("pHBHENoiseFilter", &pHBHENoiseFilter);
+    this->collisionEventSelectionName = (collisionEventSelectionName != NULL) ? collisionEventSelectionName : "";
+    if (collisionEventSelectionName != NULL) {
+        bindBranch(collisionEventSelectionName, &collisionEventSelection);
+    }
+}
+
+PhotonCollection::PhotonCollection() :
+        capacity(0), n(0), pt(NULL), eta(NULL), phi(NULL), swissCrx(NULL), seedTime(NULL),
+        sigmaIetaIeta(NULL), sigmaIphiIphi(NULL), ecalRecHitSumEtConeDR04(NULL), hcalTowerSumEtConeDR04(NULL),
+        trkSumPtHollowConeDR04(NULL), hadronicOverEm(NULL), stages(NULL)
+{
+}
+
+void PhotonCollection::bind(TTree* photonTree)
+{
+    if (tree != NULL)  unbind();
+    tree = photonTree;
+
+    capacity = TMath::Max(getMaximumLength(photonTree, "pt"), 1);
+    pt  = newFloatArray(capacity);
+    eta = newFloatArray(capacity);
+    phi = newFloatArray(capacity);
+    swissCrx = newFloatArray(capacity);
+    seedTime = newFloatArray(capacity);
+    sigmaIetaIeta = newFloatArray(capacity);
+    sigmaIphiIphi = newFloatArray(capacity);
+    ecalRecHitSumEtConeDR04 = newFloatArray(capacity);
+    hcalTowerSumEtConeDR04 = newFloatArray(capacity);
+    trkSumPtHollowConeDR04 = newFloatArray(capacity);
+    hadronicOverEm = newFloatArray(capacity);
+    stages = newUCharArray(capacity);
+
+    // the counter branch is read first
+    n = 0;
+    bindCounter("nPhotons", &n, capacity);
+    bindBranch("pt", pt);
+    bindBranch("eta", eta);
+    bindBranch("phi", phi);
+    bindBranch("swissCrx", swissCrx);
+    bindBranch("seedTime", seedTime);
+    bindBranch("sigmaIetaIeta", sigmaIetaIeta);
+    bindBranch("sigmaIphiIphi", sigmaIphiIphi);
+    bindBranch("ecalRecHitSumEtConeDR04", ecalRecHitSumEtConeDR04);
+    bindBranch("hcalTowerSumEtConeDR04", hcalTowerSumEtConeDR04);
+    bindBranch("trkSumPtHollowConeDR04", trkSumPtHollowConeDR04);
+    bindBranch("hadronicOverEm", hadronicOverEm);
+}
+
+JetCollection::JetCollection() :
+        capacity(0), n(0), pt(NULL), eta(NULL), phi(NULL)
+{
+}
+
+void JetCollection::bind(TTree* jetTree)
+{
+    if (tree != NULL)  unbind();
+    tree = jetTree;
+
+    capacity = TMath::Max(getMaximumLength(jetTree, "jtpt"), 1);
+    pt  = newFloatArray(capacity);
+    eta = newFloatArray(capacity);
+    phi = newFloatArray(capacity);
+
+    // the counter branch is read first
+    n = 0;
+    bindCounter("nref", &n, capacity);
+    bindBranch("jtpt", pt);
+    bindBranch("jteta", eta);
+    bindBranch("jtphi", phi);
+}
+
+#endif /* EVENTVIEWS_H_ */
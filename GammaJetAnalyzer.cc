@@ -5,6 +5,7 @@
  */
 
 #include "GammaJetAnalyzer.h"
+#include "GammaJetSkimWriter.h"
 
 GammaJetAnalyzer::GammaJetAnalyzer() {
 
@@ -38,6 +39,35 @@ void GammaJetAnalyzer::Constructor(){
     ak3PFJetTree   = (TTree*)this->hiForestFile->Get("ak3PFJetAnalyzer/t");
     akPu3PFJetTree = (TTree*)this->hiForestFile->Get("akPu3PFJetAnalyzer/t");
 
+    jetTree = NULL;
+    cacheEnabled = false;
+    prefetcher = NULL;
+    parallelUnzip = false;
+    skimWriter = NULL;
+    centralityBinning = NULL;
+    mixedEventPool = NULL;
+    pairObservablesEnabled = false;
+    checkpointFileName = "";
+    checkpointInterval = 0;
+    eventIndex = NULL;
+    duplicateRemovalEnabled = false;
+    bootstrap = NULL;
+    leadingPhotonTree = NULL;
+    leadingPhotonFile = NULL;
+    perf = NULL;
+    cutFlow = new CutFlow(nSelections, selectionNames);
+    eventWeight = 1;
+    for (int i=0; i<nSelections; ++i) {
+        fPt[i] = NULL;
+        fJetPt_mix[i] = NULL;
+        fPair_xJ[i] = NULL;
+    }
+    TH1D** table[nHistogramTypes] = {fPt, fSigmaIetaIeta, fPhi, fPt_2nd, fSigmaIetaIeta_2nd, fPhi_2nd,
+                                     fJetPt, fJetPhi, fJetPt_2nd, fJetPhi_2nd};
+    for (int i=0; i<nHistogramTypes; ++i) {
+        histogramTable[i] = table[i];
+    }
+
     tree = evtTree;
     tree->AddFriend(skimTree,"HltTree");
     tree->AddFriend(photonTree,"photon");
@@ -64,6 +94,8 @@ void GammaJetAnalyzer::setJetTree(jetType jet) {
     // it will not be cloned from a tree such as : jetTree = (TTree*)ak3PFJetTree->Clone();
     // jetTree points to the specified tree. Any change in "jetTree" will appear in the tree it points to.
     tree->RemoveFriend(jetTree);
+    // formulas compiled for the previous jet tree are not valid anymore
+    clearFormulaCache(tree);
 
     if(jet == ak3PFJets)  {
         jetTree = ak3PFJetTree;
@@ -78,6 +110,72 @@ void GammaJetAnalyzer::setJetTree(jetType jet) {
     tree->AddFriend(jetTree, "t");
 }
 
+/*
+ * fill the jet histograms (fJetPt, fJetPhi, fJetPt_2nd, fJetPhi_2nd) of the jet collection of "algorithm" in the event loop,
+ * in addition to the jets of setJetTree(), e.g. addJetCollection("ak4PF") reads "ak4PFJetAnalyzer/t".
+ * Any number of collections can be added. Photons are selected once per entry, the leading and subleading jets of every
+ * collection are found for the same leading photons and jet cuts. The histograms of a collection are named after the
+ * selection stage and the algorithm, e.g. "fJetPt_purity_ak4PF", see getJetCollectionHistogram().
+ *
+ * Centrality bins, event mixing, pair observables and skims use the jets of setJetTree() only.
+ * returns the index of the collection, -1 if the tree does not exist. A collection is not added twice.
+ */
+int GammaJetAnalyzer::addJetCollection(const char* algorithm)
+{
+    for (unsigned c=0; c<jetAlgorithms.size(); ++c)  {
+        if(jetAlgorithms[c] == algorithm)  return c;
+    }
+
+    TTree* collectionTree = (TTree*)hiForestFile->Get(Form("%sJetAnalyzer/t", algorithm));
+    if(collectionTree == NULL)  {
+        std::cout << "GammaJetAnalyzer : " << algorithm << "JetAnalyzer/t does not exist, jet collection is not added." << std::endl;
+        return -1;
+    }
+
+    jetAlgorithms.push_back(algorithm);
+    jetCollectionTrees.push_back(collectionTree);
+    jetCollections.push_back(new JetCollection());
+    jetCollectionMaxIndex.resize(jetAlgorithms.size() * nSelections, -1);
+    jetCollectionMax2ndIndex.resize(jetAlgorithms.size() * nSelections, -1);
+
+    int collection = jetAlgorithms.size() - 1;
+    if(fPt[0] != NULL)  {
+        bookJetCollectionHistograms(collection);
+    }
+    return collection;
+}
+
+int GammaJetAnalyzer::getNJetCollections() const
+{
+    return jetAlgorithms.size();
+}
+
+/*
+ * histogram of "type" (hist_jetPt, hist_jetPhi, hist_jetPt_2nd or hist_jetPhi_2nd) for selection "stage"
+ * of the jet collection of "algorithm", NULL if there is no such histogram
+ */
+TH1D* GammaJetAnalyzer::getJetCollectionHistogram(const char* algorithm, int type, int stage)
+{
+    for (unsigned c=0; c<jetAlgorithms.size(); ++c)
+    {
+        if(jetAlgorithms[c] != algorithm)  continue;
+        if(type < hist_jetPt || type >= hist_jetPt + nJetHistogramTypes)  return NULL;
+
+        unsigned index = (c * nJetHistogramTypes + type - hist_jetPt) * nSelections + stage;
+        return (index < jetCollectionHistograms.size()) ? jetCollectionHistograms[index] : NULL;
+    }
+    return NULL;
+}
+
+/*
+ * view of the jets of "collection" for the current entry. A collection of the same tree as "jetTree" shares its view,
+ * as the branches of a tree can be bound to one buffer only.
+ */
+const JetCollection& GammaJetAnalyzer::getJetCollection(int collection) const
+{
+    return (jetCollectionTrees[collection] == jetTree) ? jets : *jetCollections[collection];
+}
+
 void GammaJetAnalyzer::resetCuts(){
 
     ////////// cuts for event //////////
@@ -167,56 +265,1680 @@ void GammaJetAnalyzer::updateJetSelections() {
 }
 
 void GammaJetAnalyzer::drawMax(TString formula, TString formulaForMax, TString condition, TH1* hist){
+    PERF_SCOPED_TIMER(perf, stage_formula);
     drawMaximumGeneral(tree, formula, formulaForMax, condition, hist);
 }
 
 void GammaJetAnalyzer::drawMax(TString formula, TString formulaForMax, TString condition, TString cut, TH1* hist){
+    PERF_SCOPED_TIMER(perf, stage_formula);
     drawMaximumGeneral(tree, formula, formulaForMax, condition, cut, hist);
 }
 
 void GammaJetAnalyzer::drawMax2nd(TString formula, TString formulaForMax, TString condition, TH1* hist){
+    PERF_SCOPED_TIMER(perf, stage_formula);
     drawMaximum2ndGeneral(tree, formula, formulaForMax, condition, hist);
 }
 
 void GammaJetAnalyzer::drawMax2nd(TString formula, TString formulaForMax, TString condition, TString cut, TH1* hist){
+    PERF_SCOPED_TIMER(perf, stage_formula);
     drawMaximum2ndGeneral(tree, formula, formulaForMax, condition, cut, hist);
 }
 
 void GammaJetAnalyzer::drawMaxJet(TString jetFormula, TString formulaForJetMax, TString cond, TString cond_photon, TH1* hist)
 {
-    TString cond2 = cond.ReplaceAll("PHOTONPHI", Form("Sum$(phi*(pt == Max$(pt*(%s))))", cond_photon.Data()));
-    drawMaximumGeneral(tree, jetFormula, formulaForJetMax, cond2, Form("Max$(%s)>0", cond_photon.Data()), hist);
+    PERF_SCOPED_TIMER(perf, stage_formula);
+    TString photonCut;
+    TString cond2 = getJetCondition(cond, cond_photon, &photonCut);
+    drawMaximumGeneral(tree, jetFormula, formulaForJetMax, cond2, photonCut, hist);
 }
 
 void GammaJetAnalyzer::drawMaxJet(TString jetFormula, TString formulaForJetMax, TString cond, TString cond_photon, TString cut, TH1* hist)
 {
-    TString cond2 = cond.ReplaceAll("PHOTONPHI", Form("Sum$(phi*(pt == Max$(pt*(%s))))", cond_photon.Data()));
-    drawMaximumGeneral(tree, jetFormula, formulaForJetMax, cond2, mergeSelections(Form("Max$(%s)>0", cond_photon.Data()), cut), hist);
+    PERF_SCOPED_TIMER(perf, stage_formula);
+    TString photonCut;
+    TString cond2 = getJetCondition(cond, cond_photon, &photonCut);
+    drawMaximumGeneral(tree, jetFormula, formulaForJetMax, cond2, mergeSelections(photonCut, cut), hist);
 }
 
 void GammaJetAnalyzer::drawMaxJet2nd(TString jetFormula, TString formulaForJetMax, TString cond, TString cond_photon, TH1* hist)
 {
-    TString cond2 = cond.ReplaceAll("PHOTONPHI", Form("Sum$(phi*(pt == Max$(pt*(%s))))", cond_photon.Data()));
-    drawMaximum2ndGeneral(tree, jetFormula, formulaForJetMax, cond2, Form("Max$(%s)>0", cond_photon.Data()), hist);
+    PERF_SCOPED_TIMER(perf, stage_formula);
+    TString photonCut;
+    TString cond2 = getJetCondition(cond, cond_photon, &photonCut);
+    drawMaximum2ndGeneral(tree, jetFormula, formulaForJetMax, cond2, photonCut, hist);
 }
 
 void GammaJetAnalyzer::drawMaxJet2nd(TString jetFormula, TString formulaForJetMax, TString cond, TString cond_photon, TString cut, TH1* hist)
 {
-    TString cond2 = cond.ReplaceAll("PHOTONPHI", Form("Sum$(phi*(pt == Max$(pt*(%s))))", cond_photon.Data()));
-    drawMaximum2ndGeneral(tree, jetFormula, formulaForJetMax, cond2, mergeSelections(Form("Max$(%s)>0", cond_photon.Data()), cut), hist);
+    PERF_SCOPED_TIMER(perf, stage_formula);
+    TString photonCut;
+    TString cond2 = getJetCondition(cond, cond_photon, &photonCut);
+    drawMaximum2ndGeneral(tree, jetFormula, formulaForJetMax, cond2, mergeSelections(photonCut, cut), hist);
 }
 
-// no need to use "static" keyword in function definition after it has been used in function declaration
-TString GammaJetAnalyzer::mergeSelections(TString sel1, TString sel2)
+/*
+ * jet condition "cond" where "PHOTONPHI" is replaced by the phi of the leading photon that satisfies "cond_photon".
+ * "photonCut" is set to the selection of the events that have such a photon.
+ *
+ * If "cond_photon" is the photon selection of a stage when buildLeadingPhotons() was called, the precomputed column
+ * is used. Otherwise the leading photon is searched by the formula for every jet element, which is
+ * O(nJets x nPhotons) per event and gives the sum of the phi of the photons if several photons have the maximum pT.
+ * The order of the cuts and duplicate cuts of "cond_photon" do not matter, see CutExpression::isEquivalent().
+ */
+TString GammaJetAnalyzer::getJetCondition(TString cond, TString cond_photon, TString* photonCut)
 {
-    // this general purpose function was already implemented in "treeUtil.h"
-    return mergeCuts(sel1, sel2);
+    int stage = -1;
+    if(leadingPhotonTree != NULL)  {
+        CutExpression cut_photon(cond_photon.Data());
+        for(int k=0; k<nSelections; ++k)  {
+            if(cut_photon.isEquivalent(CutExpression(leadingPhotonConditions[k].Data())))  {
+                stage = k;
+                break;
+            }
+        }
+    }
+
+    if(stage >= 0)  {
+        *photonCut = Form("leadPhoIndex[%d] >= 0", stage);
+        return cond.ReplaceAll("PHOTONPHI", Form("leadPhoPhi[%d]", stage));
+    }
+    *photonCut = Form("Max$(%s)>0", cond_photon.Data());
+    return cond.ReplaceAll("PHOTONPHI", Form("Sum$(phi*(pt == Max$(pt*(%s))))", cond_photon.Data()));
 }
 
-GammaJetAnalyzer::~GammaJetAnalyzer() {
+/*
+ * compute the leading photon of each selection stage once per event and add the result as friend tree "leadPho" to "tree".
+ * Columns are arrays whose index is the selection stage :
+ *  leadPhoIndex[k] : index of the leading photon in the photon tree, -1 if no photon passed stage k
+ *  leadPhoPt[k], leadPhoEta[k], leadPhoPhi[k] : pT, eta, phi of the leading photon, 0 if there is no such photon
+ * Photon stages apply the photon cuts only, not the event selection, same as "cond_photon" in drawMaxJet().
+ * The photon with the largest pT is taken, the first one in the photon tree if several photons have the same pT.
+ *
+ * After this call drawMaxJet() uses the columns when "cond_photon" is the photon selection of a stage :
+ *  "1" or "nPhotons>0" (no photon cut), cond_pt_eta, cond_pt_eta && cond_spike, ... && cond_iso, cond_photon
+ * Jet formulas can refer to the columns as well, e.g. "abs(leadPhoEta[5]-jteta)".
+ * Cuts changed after this call are not in the columns, call this function again to recompute them.
+ *
+ * The tree is kept in memory, or written to "outputFileName" if it is given.
+ */
+void GammaJetAnalyzer::buildLeadingPhotons(const char* outputFileName)
+{
+    removeLeadingPhotons();
+
+    if(outputFileName != NULL)  {
+        leadingPhotonFile = new TFile(outputFileName, "RECREATE");
+    }
+    leadingPhotonTree = new TTree("leadingPhoton", "leading photon for each photon selection stage");
+    leadingPhotonTree->SetDirectory(leadingPhotonFile);
+    leadingPhotonTree->Branch("leadPhoIndex", leadPhoIndex, Form("leadPhoIndex[%d]/I", nSelections));
+    leadingPhotonTree->Branch("leadPhoPt", leadPhoPt, Form("leadPhoPt[%d]/F", nSelections));
+    leadingPhotonTree->Branch("leadPhoEta", leadPhoEta, Form("leadPhoEta[%d]/F", nSelections));
+    leadingPhotonTree->Branch("leadPhoPhi", leadPhoPhi, Form("leadPhoPhi[%d]/F", nSelections));
+
+    leadingPhotonConditions[sel_noSelection] = "1";
+    leadingPhotonConditions[sel_event] = "nPhotons>0";
+    leadingPhotonConditions[sel_eta] = cond_pt_eta;
+    leadingPhotonConditions[sel_spike] = mergeSelections(leadingPhotonConditions[sel_eta], cond_spike);
+    leadingPhotonConditions[sel_iso] = mergeSelections(leadingPhotonConditions[sel_spike], cond_iso);
+    leadingPhotonConditions[sel_purity] = mergeSelections(leadingPhotonConditions[sel_iso], cond_purity);
+
+    if(photons.tree == NULL)  {
+        bindBranches<anyCollisionTraits>();
+    }
+
+    Long64_t entries = evtTree->GetEntries();
+    for(Long64_t j = 0; j < entries; ++j)
+    {
+        {
+            PERF_SCOPED_TIMER(perf, stage_read);
+            photons.getEntry(j);
+        }
+
+        for(int k=0; k<nSelections; ++k)  {
+            leadPhoIndex[k] = -1;
+        }
+        for(int i = 0; i < photons.n; ++i)
+        {
+            UChar_t stages = (1 << sel_noSelection) | (1 << sel_event) | selectPhoton(i);
+            for(int k=0; k<nSelections; ++k)  {
+                if(!((stages >> k) & 1))  break;
+
+                if(leadPhoIndex[k] < 0 || photons.pt[i] > photons.pt[leadPhoIndex[k]])  {
+                    leadPhoIndex[k] = i;
+                }
+            }
+        }
+        for(int k=0; k<nSelections; ++k)
+        {
+            int i = leadPhoIndex[k];
+            leadPhoPt[k]  = (i >= 0) ? photons.pt[i]  : 0;
+            leadPhoEta[k] = (i >= 0) ? photons.eta[i] : 0;
+            leadPhoPhi[k] = (i >= 0) ? photons.phi[i] : 0;
+        }
+        leadingPhotonTree->Fill();
+    }
+
+    if(leadingPhotonFile != NULL)  {
+        leadingPhotonFile->cd();
+        leadingPhotonTree->Write("", TObject::kOverwrite);
+    }
+    tree->AddFriend(leadingPhotonTree, "leadPho");
+}
+
+void GammaJetAnalyzer::removeLeadingPhotons()
+{
+    if(leadingPhotonTree == NULL)  return;
+
+    tree->RemoveFriend(leadingPhotonTree);
+    if(leadingPhotonFile != NULL)  {
+        // the tree is deleted with the file
+        leadingPhotonFile->Close();
+        delete leadingPhotonFile;
+    }
+    else  {
+        delete leadingPhotonTree;
+    }
+    leadingPhotonTree = NULL;
+    leadingPhotonFile = NULL;
+}
+
+/*
+ * book the histograms filled by loop(), one histogram per selection stage.
+ * names are the same as in test/test_GammaJetAnalyzer.C, followed by "tag".
+ * If centrality bins are set, the histograms are booked for each centrality bin as well, see setCentralityBins().
+ */
+void GammaJetAnalyzer::bookHistograms(const char* tag)
+{
+    histogramTag = tag;
+    bookHistogramSet(histogramTable, tag);
+
+    centralityHistograms.clear();
+    if(centralityBinning != NULL)  {
+        bookCentralityHistograms();
+    }
+    if(mixedEventPool != NULL)  {
+        bookMixedEventHistograms();
+    }
+    if(pairObservablesEnabled)  {
+        bookPairHistograms();
+    }
+    jetCollectionHistograms.clear();
+    for (unsigned c=0; c<jetAlgorithms.size(); ++c)  {
+        bookJetCollectionHistograms(c);
+    }
+    bootstrapHistograms.clear();
+    bootstrapXJHistograms.clear();
+    if(bootstrap != NULL)  {
+        bookBootstrapHistograms();
+    }
+}
+
+/*
+ * book the histograms of every type and selection stage into "set", index is [histogram type][selection stage].
+ * Only the types [firstType, firstType + nTypes) are booked if given.
+ */
+void GammaJetAnalyzer::bookHistogramSet(TH1D** set[], const char* suffix, int firstType, int nTypes)
+{
+    const int nBins = 1000;
+    const float maxPt = 500;
+    const float maxSigmaIetaIeta = 0.1;
+    const float maxPhi = 3.5;
+
+    const char* titles[nHistogramTypes] = {"leading photon;p_{T} (GeV)", "leading photon;#sigma_{#eta #eta}", "leading photon;#phi",
+                                           "subleading photon;p_{T} (GeV)", "subleading photon;#sigma_{#eta #eta}", "subleading photon;#phi",
+                                           "leading jet;p_{T} (GeV)", "leading jet;#phi", "subleading jet;p_{T} (GeV)", "subleading jet;#phi"};
+    const float xMin[nHistogramTypes] = {0, 0, -maxPhi, 0, 0, -maxPhi, 0, -maxPhi, 0, -maxPhi};
+    const float xMax[nHistogramTypes] = {maxPt, maxSigmaIetaIeta, maxPhi, maxPt, maxSigmaIetaIeta, maxPhi, maxPt, maxPhi, maxPt, maxPhi};
+
+    for (int t=firstType; t<firstType+nTypes; ++t)  {
+        for (int i=0; i<nSelections; ++i)  {
+            set[t][i] = new TH1D(Form("%s%s%s", histogramNames[t], selectionSuffix[i], suffix), titles[t], nBins, xMin[t], xMax[t]);
+        }
+    }
+}
+
+/*
+ * book the jet histograms of "collection", names are followed by the algorithm of the collection, e.g. "fJetPt_purity_ak4PF"
+ */
+void GammaJetAnalyzer::bookJetCollectionHistograms(int collection)
+{
+    jetCollectionHistograms.resize(jetAlgorithms.size() * nJetHistogramTypes * nSelections, NULL);
+
+    TH1D** set[nHistogramTypes];
+    for (int t=0; t<nJetHistogramTypes; ++t)  {
+        set[hist_jetPt + t] = &jetCollectionHistograms[(collection * nJetHistogramTypes + t) * nSelections];
+    }
+    TString suffix = Form("_%s%s", jetAlgorithms[collection].Data(), histogramTag.Data());
+    bookHistogramSet(set, suffix.Data(), hist_jetPt, nJetHistogramTypes);
+}
+
+/*
+ * book the histograms of each centrality bin, names are followed by the label of the bin, e.g. "fPt_purity_hiBin0_20"
+ */
+void GammaJetAnalyzer::bookCentralityHistograms()
+{
+    const int nBins = centralityBinning->getNBins();
+    centralityHistograms.assign(nBins * nHistogramTypes * nSelections, NULL);
+
+    TH1D** set[nHistogramTypes];
+    for (int b=0; b<nBins; ++b)  {
+        TString suffix = Form("_%s%s", centralityBinning->getBinLabel(b).Data(), histogramTag.Data());
+        getCentralityHistogramSet(b, set);
+        bookHistogramSet(set, suffix.Data());
+    }
+}
+
+/*
+ * set "set" to the histograms of centrality bin "bin", index is [histogram type][selection stage]
+ */
+void GammaJetAnalyzer::getCentralityHistogramSet(int bin, TH1D** set[])
+{
+    for (int t=0; t<nHistogramTypes; ++t)  {
+        set[t] = &centralityHistograms[(bin * nHistogramTypes + t) * nSelections];
+    }
+}
+
+/*
+ * fill every booked histogram for each centrality bin in the same pass as the inclusive histograms.
+ * "variable" is centrality_hiBin (for PbPb) or centrality_hf4sum (for pPb), "binEdges" has nBins+1 values.
+ * e.g. 0-10/10-30/30-50/50-100 % in PbPb : setCentralityBins(centrality_hiBin, 4, {0, 20, 60, 100, 200})
+ */
+void GammaJetAnalyzer::setCentralityBins(int variable, int nBins, const float binEdges[])
+{
+    delete centralityBinning;
+    centralityBinning = new CentralityBinning(variable, nBins, binEdges);
+
+    centralityHistograms.clear();
+    if(fPt[0] != NULL)  {
+        bookCentralityHistograms();
+    }
+}
+
+/*
+ * pair the leading photon of each event with the jets of the previous "depth" events of the same event class,
+ * to estimate the combinatorial jet background. Event classes are "nVzBins" bins of vz within the vz cut and,
+ * if setCentralityBins() has been called before, the centrality bins.
+ * The pools keep at most "maxJetsPerEvent" jets per event, so memory use does not depend on the number of events.
+ *
+ * Mixed jets pass the same cuts as "cond_jet" : pT, eta and the photon-jet dphi with the leading photon of the event.
+ * The leading mixed jet of each mixed event fills fJetPt_mix and fJetPhi_mix with weight 1 / number of mixed events.
+ * depth <= 0 disables event mixing.
+ */
+void GammaJetAnalyzer::setEventMixing(int depth, int nVzBins, int maxJetsPerEvent)
+{
+    delete mixedEventPool;
+    mixedEventPool = NULL;
+    if(depth <= 0)  return;
+
+    mixedEventPool = new MixedEventPool(depth, maxJetsPerEvent, nVzBins, cut_vz, centralityBinning);
+    if(fPt[0] != NULL && fJetPt_mix[0] == NULL)  {
+        bookMixedEventHistograms();
+    }
+}
+
+void GammaJetAnalyzer::bookMixedEventHistograms()
+{
+    const int nBins = 1000;
+    const float maxPt = 500;
+    const float maxPhi = 3.5;
+
+    for (int i=0; i<nSelections; ++i)
+    {
+        fJetPt_mix[i] = new TH1D(Form("fJetPt_mix%s%s", selectionSuffix[i], histogramTag.Data()),"leading jet, mixed events;p_{T} (GeV)",nBins,0,maxPt);
+        fJetPhi_mix[i] = new TH1D(Form("fJetPhi_mix%s%s", selectionSuffix[i], histogramTag.Data()),"leading jet, mixed events;#phi",nBins,-maxPhi,maxPhi);
+        // filled with weights, the sum of squares of weights is allocated here instead of at the first weighted fill in the loop
+        fJetPt_mix[i]->Sumw2();
+        fJetPhi_mix[i]->Sumw2();
+    }
+}
+
+/*
+ * fill photon-jet pair observables in the event loop : for the leading photon of each selection stage,
+ * every jet that passes the jet selection ("cond_jet") makes a pair that fills
+ * fPair_jetPt, fPair_xJ (jet pT / photon pT), fPair_dphi, fPair_deta and fPair_dR.
+ */
+void GammaJetAnalyzer::enablePairObservables()
+{
+    pairObservablesEnabled = true;
+    if(fPt[0] != NULL && fPair_xJ[0] == NULL)  {
+        bookPairHistograms();
+    }
+    if(fPt[0] != NULL && bootstrap != NULL && bootstrapXJHistograms.empty())  {
+        bookBootstrapXJHistograms();
+    }
+}
+
+/*
+ * fill "nReplicas" bootstrap replicas of the inclusive histograms (fPt, ..., fJetPhi_2nd) and of fPair_xJ in the event loop.
+ * Every event has a Poisson(1) weight for each replica, replica "r" is filled with weight "r" of the event, see PoissonBootstrap.h.
+ * The weights depend only on the event (run, lumi, evt) and "seed", so loop(), loopParallel() and checkpoints give the same
+ * replicas. The statistical uncertainty of a derived quantity is its spread over the replicas, e.g. divide the replicas of
+ * the numerator and the denominator one by one and use PoissonBootstrap::setBinErrors().
+ *
+ * Each replica is a full set of histograms, memory grows with "nReplicas". nReplicas <= 0 disables the bootstrap.
+ */
+void GammaJetAnalyzer::setBootstrap(int nReplicas, ULong64_t seed)
+{
+    delete bootstrap;
+    bootstrap = NULL;
+    bootstrapHistograms.clear();
+    bootstrapXJHistograms.clear();
+    if(nReplicas <= 0)  return;
+
+    bootstrap = new PoissonBootstrap(nReplicas, seed);
+    bootstrapWeights.assign(nReplicas, 0);
+    if(fPt[0] != NULL)  {
+        bookBootstrapHistograms();
+    }
+}
+
+/*
+ * book the replicas of the inclusive histograms, names are followed by the replica, e.g. "fPt_purity_boot7"
+ */
+void GammaJetAnalyzer::bookBootstrapHistograms()
+{
+    const int nReplicas = bootstrap->getNReplicas();
+    bootstrapHistograms.assign(nReplicas * nHistogramTypes * nSelections, NULL);
+
+    TH1D** set[nHistogramTypes];
+    for (int r=0; r<nReplicas; ++r)  {
+        TString suffix = Form("_boot%d%s", r, histogramTag.Data());
+        getBootstrapHistogramSet(r, set);
+        bookHistogramSet(set, suffix.Data());
+    }
+    // replicas are filled with weights, the sums of squares are not allocated by the first fill in the loop
+    for (unsigned i=0; i<bootstrapHistograms.size(); ++i)  {
+        bootstrapHistograms[i]->Sumw2();
+    }
+    if(pairObservablesEnabled)  {
+        bookBootstrapXJHistograms();
+    }
+}
+
+void GammaJetAnalyzer::bookBootstrapXJHistograms()
+{
+    const int nReplicas = bootstrap->getNReplicas();
+    bootstrapXJHistograms.assign(nReplicas * nSelections, NULL);
+    for (int r=0; r<nReplicas; ++r)  {
+        for (int i=0; i<nSelections; ++i)  {
+            bootstrapXJHistograms[r * nSelections + i] = (TH1D*)fPair_xJ[i]->Clone(Form("%s_boot%d", fPair_xJ[i]->GetName(), r));
+            bootstrapXJHistograms[r * nSelections + i]->Reset();
+            bootstrapXJHistograms[r * nSelections + i]->Sumw2();
+        }
+    }
+}
+
+/*
+ * set "set" to the histograms of bootstrap replica "replica", index is [histogram type][selection stage]
+ */
+void GammaJetAnalyzer::getBootstrapHistogramSet(int replica, TH1D** set[])
+{
+    for (int t=0; t<nHistogramTypes; ++t)  {
+        set[t] = &bootstrapHistograms[(replica * nHistogramTypes + t) * nSelections];
+    }
+}
+
+/*
+ * replica "replica" of the histogram of "type" (see histogramType) for selection "stage", NULL if there is no such histogram
+ */
+TH1D* GammaJetAnalyzer::getBootstrapHistogram(int replica, int type, int stage)
+{
+    if(bootstrap == NULL || replica < 0 || replica >= bootstrap->getNReplicas())  return NULL;
+    if((int)bootstrapHistograms.size() <= replica * nHistogramTypes * nSelections)  return NULL;
+
+    return bootstrapHistograms[(replica * nHistogramTypes + type) * nSelections + stage];
+}
+
+/*
+ * replica "replica" of fPair_xJ for selection "stage", NULL if there is no such histogram
+ */
+TH1D* GammaJetAnalyzer::getBootstrapXJHistogram(int replica, int stage)
+{
+    if(bootstrap == NULL || replica < 0 || replica >= bootstrap->getNReplicas())  return NULL;
+    if((int)bootstrapXJHistograms.size() <= replica * nSelections)  return NULL;
+
+    return bootstrapXJHistograms[replica * nSelections + stage];
+}
+
+/*
+ * (run, lumi, evt) index of "evtTree". The index is built by a pass over the run, lumi and evt branches at the first call,
+ * it is read from "indexFileName" if the file has an index of this HiForest file, otherwise it is written into the file
+ * for later jobs. indexFileName = NULL uses a file next to the HiForest file, see EventIndex::getDefaultFileName().
+ * returns NULL if the index cannot be built.
+ */
+EventIndex* GammaJetAnalyzer::getEventIndex(const char* indexFileName)
+{
+    if(eventIndex == NULL)  {
+        eventIndex = EventIndex::open(evtTree, indexFileName);
+    }
+    return eventIndex;
+}
+
+/*
+ * skip the entries of the event loop whose (run, lumi, evt) is the same as the one of a previous entry,
+ * so that merged datasets with duplicate events can be used as they are. The first entry of an event is kept.
+ * Skipped entries are not read and are not part of the cut flow. The draw functions (drawMax(), ...) are not affected.
+ */
+void GammaJetAnalyzer::removeDuplicateEvents(bool remove)
+{
+    duplicateRemovalEnabled = remove && getEventIndex() != NULL;
+    if(duplicateRemovalEnabled)  {
+        std::cout << "GammaJetAnalyzer : " << eventIndex->getNDuplicates() << " duplicate entries out of " << eventIndex->getEntries()
+                  << " are skipped by the event loop." << std::endl;
+    }
+}
+
+/*
+ * read every tree of the HiForest file for the event (run, lumi, evt), e.g. for an event display or for debugging.
+ * returns the entry of the event, -1 if there is no such event.
+ */
+Long64_t GammaJetAnalyzer::readEvent(Int_t run, Int_t lumi, Int_t evt)
+{
+    if(getEventIndex() == NULL)  return -1;
+
+    Long64_t entry = eventIndex->getEntry(run, lumi, evt);
+    if(entry < 0)  {
+        std::cout << "GammaJetAnalyzer : there is no event with run = " << run << ", lumi = " << lumi << ", evt = " << evt << "." << std::endl;
+        return -1;
+    }
+    tree->GetEntry(entry);
+    return entry;
+}
+
+void GammaJetAnalyzer::bookPairHistograms()
+{
+    const int nBins = 1000;
+    const float maxPt = 500;
+    const float maxXJ = 5;
+    const float maxDphi = 3.5;
+    const float maxDeta = 6;
+    const float maxDR = 7;
+
+    for (int i=0; i<nSelections; ++i)
+    {
+        fPair_jetPt[i] = new TH1D(Form("fPair_jetPt%s%s", selectionSuffix[i], histogramTag.Data()),"photon-tagged jets;jet p_{T} (GeV)",nBins,0,maxPt);
+        fPair_xJ[i] = new TH1D(Form("fPair_xJ%s%s", selectionSuffix[i], histogramTag.Data()),"photon-tagged jets;x_{J#gamma} = p_{T}^{jet}/p_{T}^{#gamma}",nBins,0,maxXJ);
+        fPair_dphi[i] = new TH1D(Form("fPair_dphi%s%s", selectionSuffix[i], histogramTag.Data()),"photon-tagged jets;|#Delta#phi_{#gamma jet}|",nBins,0,maxDphi);
+        fPair_deta[i] = new TH1D(Form("fPair_deta%s%s", selectionSuffix[i], histogramTag.Data()),"photon-tagged jets;#Delta#eta_{#gamma jet}",nBins,-maxDeta,maxDeta);
+        fPair_dR[i] = new TH1D(Form("fPair_dR%s%s", selectionSuffix[i], histogramTag.Data()),"photon-tagged jets;#DeltaR_{#gamma jet}",nBins,0,maxDR);
+    }
+}
+
+/*
+ * histogram of "type" (see histogramType) for selection "stage" in centrality bin "bin", NULL if there is no such histogram
+ */
+TH1D* GammaJetAnalyzer::getCentralityHistogram(int bin, int type, int stage)
+{
+    if(centralityBinning == NULL || bin < 0 || bin >= centralityBinning->getNBins())  return NULL;
+    if((int)centralityHistograms.size() <= bin * nHistogramTypes * nSelections)       return NULL;
+
+    return centralityHistograms[(bin * nHistogramTypes + type) * nSelections + stage];
+}
+
+/*
+ * loop over the entries of the HiForest and fill the histograms booked by bookHistograms().
+ * The loop gives the same histograms as the drawMax* functions, but all of them are filled in a single pass.
+ * The cut flow is accumulated in the same pass, see "cutFlow".
+ * nEntries = -1 means all entries starting from "firstEntry".
+ *
+ * The selections use the cut values (cut_*), not the selection strings (cond_*).
+ *
+ * The buffers of the loop are allocated when the branches are bound and the histograms are booked, so the loop does not
+ * allocate on the heap per entry. Remaining allocations are made by ROOT when it reads new baskets, and by checkpoints and skims.
+ * They can be counted with HIUTILS_PERF_ALLOC, see perfAlloc.h and benchmarkAllocations() in the benchmark.
+ */
+void GammaJetAnalyzer::loop(Long64_t nEntries, Long64_t firstEntry)
+{
+    loop<anyCollisionTraits>(nEntries, firstEntry);
+}
+
+/*
+ * event loop specialized for the collision system "Traits", e.g. gja->loop<PbPbTraits>().
+ * The jet tree of the collision system is set, only the branches of the collision system are read,
+ * and the event selection includes the noise filter, the collision event selection and the centrality window.
+ */
+template <class Traits>
+void GammaJetAnalyzer::loop(Long64_t nEntries, Long64_t firstEntry)
+{
+    bool fillCentrality = prepareLoop<Traits>();
+
+    Long64_t entries = evtTree->GetEntries();
+    Long64_t lastEntry = (nEntries < 0) ? entries : TMath::Min(entries, firstEntry + nEntries);
+
+    const bool checkpoints = (checkpointFileName.Length() > 0);
+    Long64_t startEntry = firstEntry;
+    if(checkpoints)  {
+        startEntry = readCheckpoint(Traits::name(), firstEntry, lastEntry);
+    }
+
+    PERF_START_LOOP(perf, lastEntry - startEntry);
+    for(Long64_t j = startEntry; j < lastEntry; ++j)
+    {
+        PERF_PROGRESS(perf, j - startEntry);
+        if(prefetcher != NULL)  {
+            prefetcher->setEntry(j);
+        }
+
+        processEntry<Traits>(j, fillCentrality);
+        if(checkpoints && (j + 1 - firstEntry) % checkpointInterval == 0)  {
+            writeCheckpoint(Traits::name(), firstEntry, j + 1);
+        }
+    }
+    PERF_STOP_LOOP(perf);
+
+    // the last checkpoint has the final state, a restarted job does not loop again
+    if(checkpoints && startEntry < lastEntry && (lastEntry - firstEntry) % checkpointInterval != 0)  {
+        writeCheckpoint(Traits::name(), firstEntry, lastEntry);
+    }
+}
+
+/*
+ * event loop of loop<Traits>() run by "nThreads" threads, nThreads <= 0 uses one thread per core.
+ * The histograms and the cut flow are the same as the ones of loop<Traits>(), except for the event mixing histograms :
+ * every thread mixes the events of its own chunks with its own pools, so mixed events depend on the scheduling.
+ *
+ * Every thread reads its own copy of the HiForest file with its own copy of the cuts and histograms, see createLoopWorker().
+ * The entries are handed out in chunks of whole clusters by an EntryScheduler, so that the threads do not read the same
+ * baskets and threads that got expensive events (many photons and jets) do not delay the end of the loop.
+ * The histograms and the cut flow of the threads are added to the ones of this object at the end.
+ *
+ * Skims and checkpoints need the entries in order, with a skim writer or checkpoints the entries are looped by loop<Traits>().
+ * The instrumentation (see enablePerfStats()) is not collected by the threads.
+ */
+void GammaJetAnalyzer::loopParallel(int nThreads, Long64_t nEntries, Long64_t firstEntry)
+{
+    loopParallel<anyCollisionTraits>(nThreads, nEntries, firstEntry);
+}
+
+template <class Traits>
+void GammaJetAnalyzer::loopParallel(int nThreads, Long64_t nEntries, Long64_t firstEntry)
+{
+    if(nThreads <= 0)  {
+        nThreads = std::thread::hardware_concurrency();
+    }
+    if(nThreads > 1 && (skimWriter != NULL || checkpointFileName.Length() > 0))  {
+        std::cout << "GammaJetAnalyzer : skims and checkpoints need the entries in order, entries are looped by a single thread." << std::endl;
+        nThreads = 1;
+    }
+    if(nThreads <= 1)  {
+        loop<Traits>(nEntries, firstEntry);
+        return;
+    }
+
+    if(fPt[0] == NULL)  {
+        bookHistograms();
+    }
+    if(Traits::jet >= 0)  {
+        setJetTree((jetType)Traits::jet);
+    }
+
+    Long64_t entries = evtTree->GetEntries();
+    Long64_t lastEntry = (nEntries < 0) ? entries : TMath::Min(entries, firstEntry + nEntries);
+
+    // objects of the threads are created by this thread, the threads only read and fill
+    ROOT::EnableThreadSafety();
+    std::vector<GammaJetAnalyzer*> workers(nThreads);
+    std::vector<char> fillCentrality(nThreads);
+    for (int t=0; t<nThreads; ++t)  {
+        workers[t] = createLoopWorker();
+        fillCentrality[t] = workers[t]->prepareLoop<Traits>();
+    }
+
+    TTree* trees[nTreeIndices];
+    for (int i=0; i<nTreeIndices; ++i)  {
+        trees[i] = getLoopTree(i);
+    }
+    EntryScheduler scheduler(nTreeIndices, trees, firstEntry, lastEntry, nThreads);
+
+    std::vector<std::thread> threads;
+    for (int t=0; t<nThreads; ++t)
+    {
+        threads.push_back(std::thread([&scheduler, &workers, &fillCentrality, t]() {
+            Long64_t first, last;
+            while(scheduler.next(t, &first, &last))  {
+                for(Long64_t j = first; j < last; ++j)  {
+                    workers[t]->processEntry<Traits>(j, fillCentrality[t]);
+                }
+            }
+        }));
+    }
+    for (int t=0; t<nThreads; ++t)  {
+        threads[t].join();
+    }
+
+    std::vector<TH1D*> histograms = getLoopHistograms();
+    for (int t=0; t<nThreads; ++t)
+    {
+        std::vector<TH1D*> workerHistograms = workers[t]->getLoopHistograms();
+        for (unsigned i=0; i<histograms.size(); ++i)  {
+            histograms[i]->Add(workerHistograms[i]);
+            delete workerHistograms[i];
+        }
+        cutFlow->merge(workers[t]->cutFlow);
+
+        TFile* workerFile = workers[t]->hiForestFile;
+        // the index belongs to this object
+        workers[t]->eventIndex = NULL;
+        delete workers[t];
+        delete workerFile;
+    }
+}
+
+/*
+ * analyzer for a thread of loopParallel() : it opens the same HiForest file and has the same jet tree, jet collections, cuts,
+ * event weight, centrality bins, event mixing, pair observables, duplicate removal, bootstrap and caches as this object.
+ * Its histograms are not in a directory, they are deleted after they are added to the histograms of this object.
+ * The selection strings (cond_*) are not copied, the loop uses the cut values only.
+ */
+GammaJetAnalyzer* GammaJetAnalyzer::createLoopWorker()
+{
+    TDirectory* currentDirectory = gDirectory;
+    GammaJetAnalyzer* worker = new GammaJetAnalyzer(TString(hiForestFile->GetName()));
+    currentDirectory->cd();
+
+    if(jetTree == ak3PFJetTree)  {
+        worker->setJetTree(ak3PFJets);
+    }
+
+    worker->cut_vz = cut_vz;
+    worker->cut_hiBin_gt = cut_hiBin_gt;
+    worker->cut_hiBin_lt = cut_hiBin_lt;
+    worker->cut_hf4sum_gt = cut_hf4sum_gt;
+    worker->cut_hf4sum_lt = cut_hf4sum_lt;
+    worker->cut_pHBHENoiseFilter = cut_pHBHENoiseFilter;
+    worker->cut_pPAcollisionEventSelectionPA = cut_pPAcollisionEventSelectionPA;
+    worker->cut_pcollisionEventSelection = cut_pcollisionEventSelection;
+    worker->cut_pt = cut_pt;
+    worker->cut_eta = cut_eta;
+    worker->cut_swissCross = cut_swissCross;
+    worker->cut_seedTime = cut_seedTime;
+    worker->cut_sigmaIetaIeta_gt = cut_sigmaIetaIeta_gt;
+    worker->cut_sigmaIphiIphi = cut_sigmaIphiIphi;
+    worker->cut_ecalIso = cut_ecalIso;
+    worker->cut_hcalIso = cut_hcalIso;
+    worker->cut_trackIso = cut_trackIso;
+    worker->cut_hadronicOverEm = cut_hadronicOverEm;
+    worker->cut_sigmaIetaIeta_lt = cut_sigmaIetaIeta_lt;
+    worker->cut_isEle = cut_isEle;
+    worker->cut_jet_pt = cut_jet_pt;
+    worker->cut_jet_eta = cut_jet_eta;
+    worker->cut_jet_photon_deltaR = cut_jet_photon_deltaR;
+    worker->cut_jet_photon_deltaPhi = cut_jet_photon_deltaPhi;
+    worker->eventWeight = eventWeight;
+
+    if(centralityBinning != NULL)  {
+        worker->centralityBinning = new CentralityBinning(*centralityBinning);
+    }
+    if(mixedEventPool != NULL)  {
+        worker->mixedEventPool = new MixedEventPool(*mixedEventPool);
+        worker->mixedEventPool->reset();
+    }
+    worker->pairObservablesEnabled = pairObservablesEnabled;
+    // the index is read-only in the loop, it is shared
+    worker->eventIndex = eventIndex;
+    worker->duplicateRemovalEnabled = duplicateRemovalEnabled;
+    if(bootstrap != NULL)  {
+        worker->setBootstrap(bootstrap->getNReplicas(), bootstrap->getSeed());
+    }
+    for(unsigned c=0; c<jetAlgorithms.size(); ++c)  {
+        worker->addJetCollection(jetAlgorithms[c].Data());
+    }
+    if(cacheEnabled)  {
+        worker->setupCache(cacheSize, cacheLearnEntries);
+    }
+
+    bool addDirectory = TH1::AddDirectoryStatus();
+    TH1::AddDirectory(kFALSE);
+    worker->bookHistograms(histogramTag.Data());
+    TH1::AddDirectory(addDirectory);
+
+    return worker;
+}
+
+/*
+ * save the state of loop() into "fileName" every "interval" entries and at the end of the loop :
+ * the next entry, the histograms filled by the loop, the cut flow and the event mixing pools.
+ * If "fileName" exists when loop() starts, e.g. when a preempted job is restarted, the state is restored
+ * and the loop continues from the saved entry, so the final histograms and cut flow are the same as for an uninterrupted loop.
+ *
+ * A checkpoint is used only if it was written for the same HiForest file, collision system, first entry, histograms and cuts,
+ * see getLoopConfiguration(). The loop can be continued beyond the last entry of the checkpoint,
+ * e.g. loop(1000) followed by loop() in a new job loops over the entries after the first 1000 only.
+ * The histograms and the cut flow must not be filled by another loop before the restored one.
+ * Rows of a skim are not part of the state, skims must be written by an uninterrupted loop.
+ *
+ * The checkpoint is written into "fileName.tmp" and then renamed, so a job stopped while writing keeps the previous checkpoint.
+ * The checkpoint is not deleted after the loop. fileName = NULL disables checkpoints.
+ */
+void GammaJetAnalyzer::setCheckpoint(const char* fileName, Long64_t interval)
+{
+    checkpointFileName = (fileName != NULL) ? fileName : "";
+    checkpointInterval = TMath::Max(interval, (Long64_t)1);
+}
+
+/*
+ * histograms filled by loop() : inclusive, centrality, event mixing, pair, jet collection and bootstrap histograms
+ */
+std::vector<TH1D*> GammaJetAnalyzer::getLoopHistograms()
+{
+    std::vector<TH1D*> histograms;
+    for(int t=0; t<nHistogramTypes; ++t)  {
+        for(int i=0; i<nSelections; ++i)  {
+            histograms.push_back(histogramTable[t][i]);
+        }
+    }
+    histograms.insert(histograms.end(), centralityHistograms.begin(), centralityHistograms.end());
+    for(int i=0; i<nSelections; ++i)  {
+        if(mixedEventPool != NULL && fJetPt_mix[i] != NULL)  {
+            histograms.push_back(fJetPt_mix[i]);
+            histograms.push_back(fJetPhi_mix[i]);
+        }
+        if(pairObservablesEnabled && fPair_xJ[i] != NULL)  {
+            histograms.push_back(fPair_jetPt[i]);
+            histograms.push_back(fPair_xJ[i]);
+            histograms.push_back(fPair_dphi[i]);
+            histograms.push_back(fPair_deta[i]);
+            histograms.push_back(fPair_dR[i]);
+        }
+    }
+    histograms.insert(histograms.end(), jetCollectionHistograms.begin(), jetCollectionHistograms.end());
+    histograms.insert(histograms.end(), bootstrapHistograms.begin(), bootstrapHistograms.end());
+    histograms.insert(histograms.end(), bootstrapXJHistograms.begin(), bootstrapXJHistograms.end());
+    return histograms;
+}
+
+/*
+ * everything that changes the result of loop() other than the entries : input file, collision system, jet tree,
+ * histograms and cuts. Checkpoints store the hash of this string.
+ */
+TString GammaJetAnalyzer::getLoopConfiguration(const char* systemName)
+{
+    TString config = Form("%s;%s;%s;%s;%d", hiForestFile->GetName(), systemName, (jetTree == ak3PFJetTree) ? "ak3PF" : "akPu3PF",
+                          histogramTag.Data(), (int)getLoopHistograms().size());
+    config += Form(";%.9g;%d;%d;%.9g;%.9g;%d;%d;%d", cut_vz, cut_hiBin_gt, cut_hiBin_lt, cut_hf4sum_gt, cut_hf4sum_lt,
+                   cut_pHBHENoiseFilter, cut_pPAcollisionEventSelectionPA, cut_pcollisionEventSelection);
+    config += Form(";%.9g;%.9g;%.9g;%.9g;%.9g;%.9g;%.9g;%.9g;%.9g;%.9g;%.9g;%d", cut_pt, cut_eta,
+                   cut_swissCross, cut_seedTime, cut_sigmaIetaIeta_gt, cut_sigmaIphiIphi,
+                   cut_ecalIso, cut_hcalIso, cut_trackIso, cut_hadronicOverEm, cut_sigmaIetaIeta_lt, cut_isEle);
+    config += Form(";%.9g;%.9g;%.9g;%.9g", cut_jet_pt, cut_jet_eta, cut_jet_photon_deltaR, cut_jet_photon_deltaPhi);
+    config += Form(";%.17g", eventWeight);
+    if(centralityBinning != NULL)  {
+        for(int b=0; b<centralityBinning->getNBins(); ++b)  {
+            config += ";" + centralityBinning->getBinLabel(b);
+        }
+    }
+    if(mixedEventPool != NULL)  {
+        config += Form(";mix%d_%d", mixedEventPool->getDepth(), mixedEventPool->getNClasses());
+    }
+    for(unsigned c=0; c<jetAlgorithms.size(); ++c)  {
+        config += ";" + jetAlgorithms[c];
+    }
+    if(duplicateRemovalEnabled)  {
+        config += ";nodupes";
+    }
+    if(bootstrap != NULL)  {
+        config += Form(";boot%d_%llu", bootstrap->getNReplicas(), bootstrap->getSeed());
+    }
+    return config;
+}
+
+/*
+ * restore the state saved by writeCheckpoint(), returns the entry from which the loop continues.
+ * Returns "firstEntry" and changes nothing if there is no checkpoint that can be used.
+ */
+Long64_t GammaJetAnalyzer::readCheckpoint(const char* systemName, Long64_t firstEntry, Long64_t lastEntry)
+{
+    // AccessPathName() is true if the file does not exist
+    if(gSystem->AccessPathName(checkpointFileName.Data()))  return firstEntry;
+
+    TDirectory* currentDirectory = gDirectory;
+    TFile* file = TFile::Open(checkpointFileName.Data(), "READ");
+    if(file == NULL || file->IsZombie())  {
+        std::cout << "GammaJetAnalyzer : checkpoint " << checkpointFileName.Data() << " cannot be read, loop starts from entry "
+                  << firstEntry << "." << std::endl;
+        delete file;
+        currentDirectory->cd();
+        return firstEntry;
+    }
+
+    // header is {hash of the configuration, first entry, next entry}
+    std::vector<Long64_t>* header = NULL;
+    file->GetObject("checkpoint", header);
+    Long64_t hash = getLoopConfiguration(systemName).Hash();
+
+    Long64_t nextEntry = -1;
+    if(header == NULL || header->size() != 3)  {
+        std::cout << "GammaJetAnalyzer : " << checkpointFileName.Data() << " is not a checkpoint." << std::endl;
+    }
+    else if((*header)[0] != hash || (*header)[1] != firstEntry)  {
+        std::cout << "GammaJetAnalyzer : checkpoint " << checkpointFileName.Data()
+                  << " was written for another input, first entry, histograms or cuts." << std::endl;
+    }
+    else if((*header)[2] > lastEntry)  {
+        std::cout << "GammaJetAnalyzer : checkpoint " << checkpointFileName.Data() << " is at entry " << (*header)[2]
+                  << ", after the last entry of the loop." << std::endl;
+    }
+    else  {
+        nextEntry = (*header)[2];
+    }
+    delete header;
+
+    // every histogram must be in the checkpoint with the same binning
+    std::vector<TH1D*> histograms = getLoopHistograms();
+    std::vector<TH1D*> saved(histograms.size(), NULL);
+    for(unsigned i=0; i<histograms.size() && nextEntry >= 0; ++i)  {
+        saved[i] = (TH1D*)file->Get(Form("histograms/%s", histograms[i]->GetName()));
+        if(saved[i] == NULL || saved[i]->GetNbinsX() != histograms[i]->GetNbinsX())  {
+            std::cout << "GammaJetAnalyzer : checkpoint " << checkpointFileName.Data() << " has no histogram "
+                      << histograms[i]->GetName() << " with " << histograms[i]->GetNbinsX() << " bins." << std::endl;
+            nextEntry = -1;
+        }
+    }
+
+    if(nextEntry >= 0 && mixedEventPool != NULL && !mixedEventPool->loadState(file))  {
+        nextEntry = -1;
+    }
+    if(nextEntry >= 0 && !cutFlow->loadState(file))  {
+        if(mixedEventPool != NULL)  mixedEventPool->reset();
+        nextEntry = -1;
+    }
+
+    if(nextEntry >= 0)  {
+        for(unsigned i=0; i<histograms.size(); ++i)  {
+            histograms[i]->Reset();
+            histograms[i]->Add(saved[i]);
+        }
+        std::cout << "GammaJetAnalyzer : loop continues from entry " << nextEntry << " of checkpoint "
+                  << checkpointFileName.Data() << "." << std::endl;
+        if(skimWriter != NULL && nextEntry > firstEntry)  {
+            std::cout << "GammaJetAnalyzer : skim has no rows for the entries before " << nextEntry << "." << std::endl;
+        }
+    }
+    else  {
+        std::cout << "GammaJetAnalyzer : checkpoint is not used, loop starts from entry " << firstEntry << "." << std::endl;
+        nextEntry = firstEntry;
+    }
+
+    // histograms read from the file are deleted with the file
+    file->Close();
+    delete file;
+    currentDirectory->cd();
+    return nextEntry;
+}
+
+/*
+ * save the state of the loop before "nextEntry" into the checkpoint file, see setCheckpoint()
+ */
+void GammaJetAnalyzer::writeCheckpoint(const char* systemName, Long64_t firstEntry, Long64_t nextEntry)
+{
+    TDirectory* currentDirectory = gDirectory;
+    TString tmpFileName = checkpointFileName + ".tmp";
+    TFile* file = new TFile(tmpFileName.Data(), "RECREATE");
+    if(file->IsZombie())  {
+        std::cout << "GammaJetAnalyzer : checkpoint " << tmpFileName.Data() << " cannot be written." << std::endl;
+        delete file;
+        currentDirectory->cd();
+        return;
+    }
+
+    std::vector<Long64_t> header;
+    header.push_back(getLoopConfiguration(systemName).Hash());
+    header.push_back(firstEntry);
+    header.push_back(nextEntry);
+    file->WriteObject(&header, "checkpoint");
+
+    TDirectory* histogramDirectory = file->mkdir("histograms");
+    std::vector<TH1D*> histograms = getLoopHistograms();
+    for(unsigned i=0; i<histograms.size(); ++i)  {
+        histogramDirectory->WriteTObject(histograms[i]);
+    }
+    cutFlow->saveState(file);
+    if(mixedEventPool != NULL)  {
+        mixedEventPool->saveState(file);
+    }
+    file->Close();
+    delete file;
+    currentDirectory->cd();
+
+    if(gSystem->Rename(tmpFileName.Data(), checkpointFileName.Data()) != 0)  {
+        std::cout << "GammaJetAnalyzer : " << tmpFileName.Data() << " cannot be renamed to " << checkpointFileName.Data() << "." << std::endl;
+    }
+}
+
+/*
+ * write a row to "skimWriter" for every entry of loop(), NULL stops writing.
+ * The writer is not owned by the analyzer.
+ */
+void GammaJetAnalyzer::setSkimWriter(GammaJetSkimWriter* skimWriter)
+{
+    this->skimWriter = skimWriter;
+}
+
+GammaJetSkimWriter* GammaJetAnalyzer::getSkimWriter() const
+{
+    return skimWriter;
+}
+
+/*
+ * bind the views of the event loop (event, skim, photons, jets) to the trees as required by the collision system "Traits".
+ * Only the branches of the views are read by the loop, other branches are not touched.
+ * A view is bound again if the collision system or the jet tree (see setJetTree()) has changed since the last loop.
+ */
+template <class Traits>
+void GammaJetAnalyzer::bindBranches()
+{
+    bool rebound[nTreeIndices] = {false, false, false, false};
+
+    if(event.tree == NULL || event.centrality != Traits::centrality)  {
+        event.bind(evtTree, Traits::centrality);
+        rebound[evtIndex] = true;
+    }
+
+    if(Traits::skimFlag == skimFlag_none)  {
+        if(skim.tree != NULL)  {
+            skim.unbind();
+            rebound[skimIndex] = true;
+        }
+    }
+    else if(skim.tree == NULL || skim.collisionEventSelectionName != skimFlagNames[Traits::skimFlag])  {
+        skim.bind(skimTree, skimFlagNames[Traits::skimFlag]);
+        rebound[skimIndex] = true;
+    }
+
+    if(photons.tree == NULL)  {
+        photons.bind(photonTree);
+        rebound[photonIndex] = true;
+    }
+
+    // a jet collection of the main jet tree uses "jets", the branches of a tree can be bound to a single view.
+    // Its own view is unbound before "jets" is bound, as unbinding resets the branch addresses.
+    bool jetCollectionRebound = false;
+    for (unsigned c=0; c<jetCollections.size(); ++c)  {
+        if(jetCollectionTrees[c] == jetTree && jetCollections[c]->tree != NULL)  {
+            jetCollections[c]->unbind();
+            jets.unbind();
+        }
+    }
+
+    if(jets.tree != jetTree)  {
+        jets.bind(jetTree);
+        rebound[jetIndex] = true;
+    }
+
+    for (unsigned c=0; c<jetCollections.size(); ++c)  {
+        if(jetCollectionTrees[c] != jetTree && jetCollections[c]->tree == NULL)  {
+            jetCollections[c]->bind(jetCollectionTrees[c]);
+            if(cacheEnabled)  {
+                setCacheForJetCollection(c);
+            }
+            jetCollectionRebound = true;
+        }
+    }
+    // buffers of the pair observables hold every jet of an entry
+    pair_xJ.resize(jets.capacity);
+    pair_dphi.resize(jets.capacity);
+    pair_deta.resize(jets.capacity);
+    pair_dR.resize(jets.capacity);
+
+    // caches and prefetching were set up for the previous branches
+    bool anyRebound = false;
+    for (int i=0; i<nTreeIndices; ++i)  {
+        if(!rebound[i])  continue;
+
+        anyRebound = true;
+        if(cacheEnabled)  {
+            setCacheForTree(i);
+        }
+    }
+    if((anyRebound || jetCollectionRebound) && prefetcher != NULL)  {
+        startPrefetcher();
+    }
+}
+
+TTree* GammaJetAnalyzer::getLoopTree(int treeIndex)
+{
+    if(treeIndex == evtIndex)          return evtTree;
+    else if(treeIndex == skimIndex)    return skimTree;
+    else if(treeIndex == photonIndex)  return photonTree;
+    else                               return jetTree;
+}
+
+/*
+ * branches of the tree "treeIndex" that are read by the event loop
+ */
+TreeView* GammaJetAnalyzer::getLoopView(int treeIndex)
+{
+    if(treeIndex == evtIndex)          return &event;
+    else if(treeIndex == skimIndex)    return &skim;
+    else if(treeIndex == photonIndex)  return &photons;
+    else                               return &jets;
+}
+
+const std::vector<TBranch*>& GammaJetAnalyzer::getLoopBranches(int treeIndex)
+{
+    return getLoopView(treeIndex)->branches;
+}
+
+/*
+ * configure the TTreeCache of each tree (HiTree, HltTree, photon and jet trees) so that the baskets of each tree are
+ * fetched in a few large reads instead of many small ones.
+ *
+ * The caches are sized from the compressed size of the branches used by the event loop (see setCacheForBranches()),
+ * cacheSize >= 0 sets the same size for every tree instead.
+ * During the first "learnEntries" entries the caches learn further branches that are read, e.g. by TTree::Draw().
+ *
+ * If "prefetch" is true, a background thread reads ahead the baskets of the next "prefetchClusters" clusters of the
+ * event loop, so that reading overlaps with the computation, see ClusterPrefetcher.
+ */
+void GammaJetAnalyzer::setupCache(Long64_t cacheSize, int learnEntries, bool prefetch, int prefetchClusters)
+{
+    this->cacheEnabled = true;
+    this->cacheSize = cacheSize;
+    this->cacheLearnEntries = learnEntries;
+    this->prefetchClusters = prefetchClusters;
+
+    bindBranches<anyCollisionTraits>();
+    for (int i=0; i<nTreeIndices; ++i)  {
+        setCacheForTree(i);
+    }
+    for (unsigned c=0; c<jetCollections.size(); ++c)  {
+        if(jetCollections[c]->tree != NULL)  {
+            setCacheForJetCollection(c);
+        }
+    }
+
+    if(prefetch)  {
+        startPrefetcher();
+    }
+    else  {
+        delete prefetcher;
+        prefetcher = NULL;
+    }
+}
+
+/*
+ * decompress the baskets of the trees in parallel using ROOT's implicit multithreading.
+ * nThreads is the size of ROOT's thread pool, so that the unzipping threads can share the cores with
+ * other parallel work. nThreads < 0 uses all cores, nThreads = 0 disables parallel unzipping.
+ *
+ * The thread pool of ROOT is global : it is shared by every tree in the process.
+ * The baskets are unzipped in the TTreeCache (TTreeCacheUnzip), hence the caches are set up if they are not yet.
+ *
+ * https://root.cern.ch/doc/master/classTTreeCacheUnzip.html
+ */
+void GammaJetAnalyzer::setParallelUnzip(int nThreads)
+{
+    parallelUnzip = (nThreads != 0);
+
+    if(parallelUnzip)  {
+        setImplicitMTPoolSize(nThreads);
+    }
+
+    for (int i=0; i<nTreeIndices; ++i)  {
+        getLoopTree(i)->SetImplicitMT(parallelUnzip);
+        getLoopTree(i)->SetParallelUnzip(parallelUnzip);
+    }
+    // the other jet tree is attached later by setJetTree()
+    TTree* otherJetTree = (jetTree == ak3PFJetTree) ? akPu3PFJetTree : ak3PFJetTree;
+    otherJetTree->SetImplicitMT(parallelUnzip);
+    otherJetTree->SetParallelUnzip(parallelUnzip);
+
+    // caches are created again so that they are of the unzipping type
+    if(cacheEnabled)  {
+        for (int i=0; i<nTreeIndices; ++i)  {
+            getLoopTree(i)->SetCacheSize(0);
+            setCacheForTree(i);
+        }
+    }
+    else if(parallelUnzip)  {
+        setupCache();
+    }
+}
+
+void GammaJetAnalyzer::setCacheForTree(int treeIndex)
+{
+    const std::vector<TBranch*>& branches = getLoopBranches(treeIndex);
+    const int len = branches.size();
+    std::vector<const char*> branchNames(len);
+    for (int i=0; i<len; ++i)  {
+        branchNames[i] = branches[i]->GetName();
+    }
+
+    setCacheForBranches(getLoopTree(treeIndex), len, (len > 0) ? &branchNames[0] : NULL, cacheSize, cacheLearnEntries);
+}
+
+void GammaJetAnalyzer::setCacheForJetCollection(int collection)
+{
+    const std::vector<TBranch*>& branches = jetCollections[collection]->branches;
+    const int len = branches.size();
+    std::vector<const char*> branchNames(len);
+    for (int i=0; i<len; ++i)  {
+        branchNames[i] = branches[i]->GetName();
+    }
+
+    setCacheForBranches(jetCollectionTrees[collection], len, (len > 0) ? &branchNames[0] : NULL, cacheSize, cacheLearnEntries);
+}
+
+/*
+ * (re)start the prefetching thread for the branches of the event loop
+ */
+void GammaJetAnalyzer::startPrefetcher()
+{
+    delete prefetcher;
+
+    prefetcher = new ClusterPrefetcher(hiForestFile->GetName(), prefetchClusters * getClusterSize(photonTree));
+    for (int i=0; i<nTreeIndices; ++i)  {
+        const std::vector<TBranch*>& branches = getLoopBranches(i);
+        for (unsigned k=0; k<branches.size(); ++k)  {
+            prefetcher->addBranch(branches[k]);
+        }
+    }
+    for (unsigned c=0; c<jetCollections.size(); ++c)  {
+        for (unsigned k=0; k<jetCollections[c]->branches.size(); ++k)  {
+            prefetcher->addBranch(jetCollections[c]->branches[k]);
+        }
+    }
+
+    if(!prefetcher->start())  {
+        delete prefetcher;
+        prefetcher = NULL;
+    }
+}
+
+/*
+ * book the histograms if they are not booked yet, set the jet tree of the collision system and bind the branches.
+ * returns true if the centrality histograms are filled by the loop of "Traits".
+ */
+template <class Traits>
+bool GammaJetAnalyzer::prepareLoop()
+{
+    if(fPt[0] == NULL)  {
+        bookHistograms();
+    }
+    if(Traits::jet >= 0)  {
+        setJetTree((jetType)Traits::jet);
+    }
+    bindBranches<Traits>();
+
+    // the centrality variable of the bins must be read by the loop of the collision system
+    bool fillCentrality = (centralityBinning != NULL);
+    if(fillCentrality && Traits::centrality != centrality_all && Traits::centrality != centralityBinning->getVariable())  {
+        std::cout << "GammaJetAnalyzer : centrality bins are not filled, the centrality variable of the bins is not used by "
+                  << Traits::name() << " events." << std::endl;
+        fillCentrality = false;
+    }
+    return fillCentrality;
+}
+
+/*
+ * read, select and fill the histograms, the cut flow and the skim for "entry". Duplicate events are skipped if they are removed.
+ */
+template <class Traits>
+void GammaJetAnalyzer::processEntry(Long64_t entry, bool fillCentrality)
+{
+    if(duplicateRemovalEnabled && eventIndex->isDuplicate(entry))  return;
+
+    if(!readEntry(entry))  return;
+    selectEntry<Traits>();
+    fillHistograms();
+    if(bootstrap != NULL)  {
+        fillBootstrapHistograms();
+    }
+    if(jetAlgorithms.size() > 0)  {
+        selectJetCollections();
+        fillJetCollectionHistograms();
+    }
+    if(fillCentrality)  {
+        fillCentralityHistograms();
+    }
+    if(mixedEventPool != NULL)  {
+        mixEvent();
+    }
+    if(pairObservablesEnabled)  {
+        fillPairHistograms();
+    }
+    fillCutFlow();
+    if(skimWriter != NULL)  {
+        skimWriter->fill(entry);
+    }
+}
+
+/*
+ * read the branches of the event loop for "entry".
+ * returns false if the entry has more photons or jets than the buffers hold, see TreeView::getEntry(), the entry is skipped.
+ */
+bool GammaJetAnalyzer::readEntry(Long64_t entry)
+{
+    PERF_SCOPED_TIMER(perf, stage_read);
+
+    for (int i=0; i<nTreeIndices; ++i)
+    {
+        Long64_t bytes = getLoopView(i)->getEntry(entry);
+        if(bytes < 0)  return false;
+        // the ak3PF jet tree has its own index in "perf"
+        PERF_ADD_BYTES(perf, perfTreeIndex[(i == jetIndex && jetTree == ak3PFJetTree) ? nTreeIndices : i], bytes);
+    }
+    // jet collections of the main jet tree are read above
+    for (unsigned c=0; c<jetCollections.size(); ++c)  {
+        if(jetCollections[c]->tree != NULL && jetCollections[c]->getEntry(entry) < 0)  return false;
+    }
+    return true;
+}
+
+/*
+ * photon selection stages passed by photon "i" of the current entry, without the event selection.
+ * bit k is set if the photon passed stage k, for k = sel_eta, ..., sel_purity. Stages are cumulative.
+ */
+UChar_t GammaJetAnalyzer::selectPhoton(int i)
+{
+    bool passed[nSelections];
+    // eta cut includes photon pT cut as well.
+    passed[sel_eta] = (TMath::Abs(photons.eta[i]) < cut_eta && photons.pt[i] > cut_pt);
+    passed[sel_spike] = (         photons.swissCrx[i] < cut_swissCross       &&
+                         TMath::Abs(photons.seedTime[i]) < cut_seedTime      &&
+                             photons.sigmaIetaIeta[i] > cut_sigmaIetaIeta_gt &&
+                             photons.sigmaIphiIphi[i] > cut_sigmaIphiIphi);
+    passed[sel_iso] = (photons.ecalRecHitSumEtConeDR04[i] < cut_ecalIso   &&
+                        photons.hcalTowerSumEtConeDR04[i] < cut_hcalIso   &&
+                        photons.trkSumPtHollowConeDR04[i] < cut_trackIso  &&
+                              photons.hadronicOverEm[i] < cut_hadronicOverEm);
+    passed[sel_purity] = (photons.sigmaIetaIeta[i] < cut_sigmaIetaIeta_lt);
+
+    UChar_t stages = 0;
+    for(int k=sel_eta; k<nSelections; ++k)  {
+        if(!passed[k])  break;
+        stages |= (1 << k);
+    }
+    return stages;
+}
+
+/*
+ * apply the cumulative selections to the current entry and find the leading and subleading photons and jets
+ * for each selection stage. Results are stored in maxPhotonIndex, maxPhoton2ndIndex, maxJetIndex, maxJet2ndIndex.
+ * The event selection of the collision system "Traits" is resolved at compile time.
+ */
+template <class Traits>
+void GammaJetAnalyzer::selectEntry()
+{
+    PERF_SCOPED_TIMER(perf, stage_selection);
+    PERF_COUNT(perf, stage_selection, photons.n + jets.n);
+
+    for(int k=0; k<nSelections; ++k)  {
+        maxPhotonIndex[k] = -1;
+        maxPhoton2ndIndex[k] = -1;
+        nPhotonsPassed[k] = 0;
+    }
+
+    bool passed[nSelections];
+    passed[sel_noSelection] = true;
+    passed[sel_event] = (TMath::Abs(event.vz) < cut_vz);
+    if(Traits::skimFlag != skimFlag_none)  {
+        int cut_collisionEventSelection = (Traits::skimFlag == skimFlag_pcollisionEventSelection) ?
+                                          cut_pcollisionEventSelection : cut_pPAcollisionEventSelectionPA;
+        passed[sel_event] = passed[sel_event] && skim.pHBHENoiseFilter > cut_pHBHENoiseFilter
+                                              && skim.collisionEventSelection > cut_collisionEventSelection;
+    }
+    if(Traits::centrality == centrality_hiBin)  {
+        passed[sel_event] = passed[sel_event] && event.hiBin > cut_hiBin_gt && event.hiBin < cut_hiBin_lt;
+    }
+    else if(Traits::centrality == centrality_hf4sum)  {
+        float hf4sum = event.hf4sum();
+        passed[sel_event] = passed[sel_event] && hf4sum > cut_hf4sum_gt && hf4sum < cut_hf4sum_lt;
+    }
+
+    for(int i = 0; i < photons.n; ++i)
+    {
+        // selections are cumulative, photon stages require the event selection
+        photons.stages[i] = (1 << sel_noSelection);
+        if(passed[sel_event])  {
+            photons.stages[i] |= (1 << sel_event) | selectPhoton(i);
+        }
+        for(int k=sel_eta; k<nSelections; ++k)  {
+            passed[k] = (photons.stages[i] >> k) & 1;
+        }
+
+        for(int k=0; k<nSelections; ++k)
+        {
+            if(!passed[k])  continue;
+
+            nPhotonsPassed[k]++;
+            // check if this photon can be subleading photon
+            if(maxPhoton2ndIndex[k] < 0 || photons.pt[i] > photons.pt[maxPhoton2ndIndex[k]])  {
+                maxPhoton2ndIndex[k] = i;
+            }
+            // check if this photon is leading photon
+            if(maxPhotonIndex[k] < 0 || photons.pt[i] > photons.pt[maxPhotonIndex[k]])  {
+                // current leading photon becomes subleading photon
+                maxPhoton2ndIndex[k] = maxPhotonIndex[k];
+                maxPhotonIndex[k] = i;
+            }
+        }
+    }
+
+    // event level stages are passed by the event itself, photon level stages need at least one photon
+    eventPassed[sel_noSelection] = passed[sel_noSelection];
+    eventPassed[sel_event] = passed[sel_event];
+    for(int k=sel_eta; k<nSelections; ++k)  {
+        eventPassed[k] = (nPhotonsPassed[k] > 0);
+    }
+
+    selectJets(jets, maxJetIndex, maxJet2ndIndex);
+}
+
+/*
+ * find the leading and subleading jets of "jetCollection" for the leading photon of each selection stage of the current entry.
+ * indices are stored in "maxJet" and "maxJet2nd", index is the selection stage, -1 if there is no such jet.
+ */
+void GammaJetAnalyzer::selectJets(const JetCollection& jetCollection, int maxJet[], int maxJet2nd[])
+{
+    for(int k=0; k<nSelections; ++k)  {
+        maxJet[k] = -1;
+        maxJet2nd[k] = -1;
+    }
+
+    for(int i=0; i<jetCollection.n; ++i)
+    {
+        bool passed_jet = (jetCollection.pt[i] > cut_jet_pt && TMath::Abs(jetCollection.eta[i]) < cut_jet_eta);
+        if(!passed_jet)  continue;
+
+        for(int k=0; k<nSelections; ++k)
+        {
+            // there must be a leading photon for the corresponding selection
+            if(maxPhotonIndex[k] < 0)  continue;
+
+            bool passed_jet_dphi = (TMath::Abs(getDPHI(jetCollection.phi[i], photons.phi[maxPhotonIndex[k]])) >= cut_jet_photon_deltaPhi);
+            if(!passed_jet_dphi)  continue;
+
+            // check if this jet can be subleading jet
+            if(maxJet2nd[k] < 0 || jetCollection.pt[i] > jetCollection.pt[maxJet2nd[k]])  {
+                maxJet2nd[k] = i;
+            }
+            // check if this jet is leading jet
+            if(maxJet[k] < 0 || jetCollection.pt[i] > jetCollection.pt[maxJet[k]])  {
+                // current leading jet becomes subleading jet
+                maxJet2nd[k] = maxJet[k];
+                maxJet[k] = i;
+            }
+        }
+    }
+}
+
+/*
+ * leading and subleading jets of every collection of addJetCollection(), for the photons selected by selectEntry()
+ */
+void GammaJetAnalyzer::selectJetCollections()
+{
+    PERF_SCOPED_TIMER(perf, stage_selection);
+
+    for(unsigned c=0; c<jetAlgorithms.size(); ++c)  {
+        selectJets(getJetCollection(c), &jetCollectionMaxIndex[c * nSelections], &jetCollectionMax2ndIndex[c * nSelections]);
+    }
+}
+
+void GammaJetAnalyzer::fillHistograms()
+{
+    PERF_SCOPED_TIMER(perf, stage_fill);
+
+    fillHistogramSet(histogramTable);
+}
+
+/*
+ * generate the bootstrap weights of the current entry for every replica at once, then fill the replicas with them.
+ * A replica with weight 0 is not filled. The weights are used by fillPairHistograms() as well.
+ */
+void GammaJetAnalyzer::fillBootstrapHistograms()
+{
+    PERF_SCOPED_TIMER(perf, stage_fill);
+
+    bootstrap->generate(EventIndex::hash(event.run, event.lumi, event.evt), &bootstrapWeights[0]);
+
+    TH1D** set[nHistogramTypes];
+    for (int r=0; r<bootstrap->getNReplicas(); ++r)  {
+        if(bootstrapWeights[r] == 0)  continue;
+        getBootstrapHistogramSet(r, set);
+        fillHistogramSet(set, bootstrapWeights[r]);
+    }
+}
+
+/*
+ * fill the jet histograms of every collection of addJetCollection()
+ */
+void GammaJetAnalyzer::fillJetCollectionHistograms()
+{
+    PERF_SCOPED_TIMER(perf, stage_fill);
+
+    for(unsigned c=0; c<jetAlgorithms.size(); ++c)
+    {
+        const JetCollection& jetCollection = getJetCollection(c);
+        TH1D* const* hists = &jetCollectionHistograms[c * nJetHistogramTypes * nSelections];
+        for(int k=0; k<nSelections; ++k)
+        {
+            int i;
+            // leading jet
+            if((i = jetCollectionMaxIndex[c * nSelections + k]) > -1)  {
+                hists[(hist_jetPt - hist_jetPt) * nSelections + k]->Fill(jetCollection.pt[i]);
+                hists[(hist_jetPhi - hist_jetPt) * nSelections + k]->Fill(jetCollection.phi[i]);
+            }
+            // subleading jet
+            if((i = jetCollectionMax2ndIndex[c * nSelections + k]) > -1)  {
+                hists[(hist_jetPt_2nd - hist_jetPt) * nSelections + k]->Fill(jetCollection.pt[i]);
+                hists[(hist_jetPhi_2nd - hist_jetPt) * nSelections + k]->Fill(jetCollection.phi[i]);
+            }
+        }
+    }
+}
+
+/*
+ * fill the histograms of the centrality bin of the current entry. There is no search over the bins, see CentralityBinning.
+ */
+void GammaJetAnalyzer::fillCentralityHistograms()
+{
+    PERF_SCOPED_TIMER(perf, stage_fill);
+
+    float value = (centralityBinning->getVariable() == centrality_hiBin) ? event.hiBin : event.hf4sum();
+    int bin = centralityBinning->getBin(value);
+    if(bin < 0)  return;
+
+    TH1D** set[nHistogramTypes];
+    getCentralityHistogramSet(bin, set);
+    fillHistogramSet(set);
+}
+
+/*
+ * mix the leading photons of the current entry with the jets in the pool of its event class,
+ * then add the jets of the current entry to the pool. Only events that pass the event selection are mixed.
+ */
+void GammaJetAnalyzer::mixEvent()
+{
+    PERF_SCOPED_TIMER(perf, stage_fill);
+
+    if(!eventPassed[sel_event])  return;
+
+    int centralityVariable = mixedEventPool->getCentralityVariable();
+    float centrality = (centralityVariable == centrality_hiBin) ? event.hiBin : event.hf4sum();
+    int eventClass = mixedEventPool->getClass(event.vz, centrality);
+    if(eventClass < 0)  return;
+
+    const int nMixed = mixedEventPool->getNEvents(eventClass);
+    for(int k=0; k<nSelections && nMixed > 0; ++k)
+    {
+        if(maxPhotonIndex[k] < 0)  continue;
+        float photonPhi = photons.phi[maxPhotonIndex[k]];
+
+        for(int m=0; m<nMixed; ++m)
+        {
+            const mixedJet* mixedJets = mixedEventPool->getJets(eventClass, m);
+            const int nJets = mixedEventPool->getNJets(eventClass, m);
+
+            // jets in the pools passed the pT and eta cuts already
+            int leading = -1;
+            for(int i=0; i<nJets; ++i)  {
+                if(TMath::Abs(getDPHI(mixedJets[i].phi, photonPhi)) < cut_jet_photon_deltaPhi)  continue;
+                if(leading < 0 || mixedJets[i].pt > mixedJets[leading].pt)  leading = i;
+            }
+            if(leading < 0)  continue;
+
+            fJetPt_mix[k]->Fill(mixedJets[leading].pt, 1. / nMixed);
+            fJetPhi_mix[k]->Fill(mixedJets[leading].phi, 1. / nMixed);
+        }
+    }
+
+    mixedEventPool->addEvent(eventClass, jets.n, jets.pt, jets.eta, jets.phi, cut_jet_pt, cut_jet_eta);
+}
+
+/*
+ * pair the leading photon of each selection stage with every jet of the current entry.
+ * The observables are computed once per distinct leading photon by getPhotonJetPairs(), then the jet selection is applied.
+ */
+void GammaJetAnalyzer::fillPairHistograms()
+{
+    PERF_SCOPED_TIMER(perf, stage_fill);
+
+    int computedPhoton = -1;     // photon for which the pair observables are in pair_* buffers
+    for(int k=0; k<nSelections; ++k)
+    {
+        int i = maxPhotonIndex[k];
+        if(i < 0)  continue;
+
+        if(i != computedPhoton)  {
+            getPhotonJetPairs(photons.pt[i], photons.eta[i], photons.phi[i], jets.n, jets.pt, jets.eta, jets.phi,
+                              &pair_xJ[0], &pair_dphi[0], &pair_deta[0], &pair_dR[0]);
+            computedPhoton = i;
+        }
+
+        for(int j=0; j<jets.n; ++j)
+        {
+            if(jets.pt[j] <= cut_jet_pt || TMath::Abs(jets.eta[j]) >= cut_jet_eta || pair_dphi[j] < cut_jet_photon_deltaPhi)  continue;
+
+            fPair_jetPt[k]->Fill(jets.pt[j]);
+            fPair_xJ[k]->Fill(pair_xJ[j]);
+            fPair_dphi[k]->Fill(pair_dphi[j]);
+            fPair_deta[k]->Fill(pair_deta[j]);
+            fPair_dR[k]->Fill(pair_dR[j]);
+
+            for(unsigned r=0; r<bootstrapXJHistograms.size() / nSelections; ++r)  {
+                if(bootstrapWeights[r] > 0)  bootstrapXJHistograms[r * nSelections + k]->Fill(pair_xJ[j], bootstrapWeights[r]);
+            }
+        }
+    }
+}
+
+/*
+ * fill the leading/subleading photons and jets of the current entry into "set", index is [histogram type][selection stage]
+ */
+void GammaJetAnalyzer::fillHistogramSet(TH1D** const set[], double weight)
+{
+    for(int k=0; k<nSelections; ++k)
+    {
+        int i;
+        // leading photon
+        if((i = maxPhotonIndex[k]) > -1)  {
+            set[hist_pt][k]->Fill(photons.pt[i], weight);
+            set[hist_sigmaIetaIeta][k]->Fill(photons.sigmaIetaIeta[i], weight);
+            set[hist_phi][k]->Fill(photons.phi[i], weight);
+        }
+        // subleading photon
+        if((i = maxPhoton2ndIndex[k]) > -1)  {
+            set[hist_pt_2nd][k]->Fill(photons.pt[i], weight);
+            set[hist_sigmaIetaIeta_2nd][k]->Fill(photons.sigmaIetaIeta[i], weight);
+            set[hist_phi_2nd][k]->Fill(photons.phi[i], weight);
+        }
+        // leading jet
+        if((i = maxJetIndex[k]) > -1)  {
+            set[hist_jetPt][k]->Fill(jets.pt[i], weight);
+            set[hist_jetPhi][k]->Fill(jets.phi[i], weight);
+        }
+        // subleading jet
+        if((i = maxJet2ndIndex[k]) > -1)  {
+            set[hist_jetPt_2nd][k]->Fill(jets.pt[i], weight);
+            set[hist_jetPhi_2nd][k]->Fill(jets.phi[i], weight);
+        }
+    }
+}
+
+void GammaJetAnalyzer::fillCutFlow()
+{
+    PERF_SCOPED_TIMER(perf, stage_fill);
+
+    for(int k=0; k<nSelections; ++k)
+    {
+        if(eventPassed[k])  {
+            cutFlow->fill(cutFlow_event, k, eventWeight);
+        }
+        if(nPhotonsPassed[k] > 0)  {
+            cutFlow->fill(cutFlow_photon, k, eventWeight, nPhotonsPassed[k]);
+        }
+    }
+}
+
+/*
+ * start collecting per-stage timers and counters and bytes read per tree.
+ * has no effect unless the code is compiled with HIUTILS_PERF, see perfUtil.h
+ */
+void GammaJetAnalyzer::enablePerfStats()
+{
+#ifdef HIUTILS_PERF
+    if(perf != NULL)  return;
+
+    perf = new PerfStats(nAnalyzerStages, analyzerStageNames);
+    perfTreeIndex[evtIndex]    = perf->addTree(evtTree, "HiTree");
+    perfTreeIndex[skimIndex]   = perf->addTree(skimTree, "HltTree");
+    perfTreeIndex[photonIndex] = perf->addTree(photonTree, "photon");
+    perfTreeIndex[jetIndex]    = perf->addTree(akPu3PFJetTree, "akPu3PFJets");
+    perfTreeIndex[nTreeIndices] = perf->addTree(ak3PFJetTree, "ak3PFJets");
+#else
+    std::cout << "GammaJetAnalyzer : instrumentation is not compiled in, compile with -DHIUTILS_PERF to enable it." << std::endl;
+#endif
+}
+
+void GammaJetAnalyzer::printPerfStats()
+{
+    if(perf != NULL)  {
+        perf->print();
+    }
+}
+
+/*
+ * write the summary of the instrumentation into "dir", e.g. the output ROOT file
+ */
+void GammaJetAnalyzer::writePerfStats(TDirectory* dir)
+{
+    if(perf != NULL)  {
+        perf->write(dir);
+    }
+}
+
+// no need to use "static" keyword in function definition after it has been used in function declaration
+TString GammaJetAnalyzer::mergeSelections(TString sel1, TString sel2)
+{
+    // this general purpose function was already implemented in "treeUtil.h"
+    return mergeCuts(sel1, sel2);
+}
+
+GammaJetAnalyzer::~GammaJetAnalyzer() {
+
+    removeLeadingPhotons();
+    clearFormulaCache(tree);
+    delete prefetcher;
+    delete centralityBinning;
+    delete mixedEventPool;
+    delete perf;
+    delete cutFlow;
+    delete eventIndex;
+    delete bootstrap;
+    for (unsigned c=0; c<jetCollections.size(); ++c)  {
+        delete jetCollections[c];
+    }
 
     if(hiForestFile->IsOpen())   {
         hiForestFile->Close();
     }
 }
 
+// event loops for the collision systems, so that they are available when this file is loaded into ROOT
+template void GammaJetAnalyzer::loop<ppTraits>  (Long64_t nEntries, Long64_t firstEntry);
+template void GammaJetAnalyzer::loop<pPbTraits> (Long64_t nEntries, Long64_t firstEntry);
+template void GammaJetAnalyzer::loop<PbPbTraits>(Long64_t nEntries, Long64_t firstEntry);
+template void GammaJetAnalyzer::loopParallel<ppTraits>  (int nThreads, Long64_t nEntries, Long64_t firstEntry);
+template void GammaJetAnalyzer::loopParallel<pPbTraits> (int nThreads, Long64_t nEntries, Long64_t firstEntry);
+template void GammaJetAnalyzer::loopParallel<PbPbTraits>(int nThreads, Long64_t nEntries, Long64_t firstEntry);
@@ -11,19 +11,125 @@
 #include <TFile.h>
 #include <TString.h>
 #include <TTree.h>
+#include <TBranch.h>
+#include <TH1D.h>
 #include <TMath.h>
+#include <TROOT.h>
+#include <TSystem.h>
 
 #include <iostream>
+#include <vector>
+#include <thread>
 
 #include "treeUtil.h"
+#include "smallPhotonUtil.h"
+#include "perfUtil.h"
+#include "CutFlow.h"
+#include "prefetchUtil.h"
+#include "EventViews.h"
+#include "CentralityBinning.h"
+#include "MixedEventPool.h"
+#include "EntryScheduler.h"
+#include "EventIndex.h"
+#include "PoissonBootstrap.h"
 
 #define PI 3.141592653589
 
+class GammaJetSkimWriter;
+
 enum jetType {
     ak3PFJets,
     akPu3PFJets
 };
 
+// collision event selection in "skimanalysis/HltTree"
+enum skimFlagType {
+    skimFlag_none,
+    skimFlag_pcollisionEventSelection,          // for HI events
+    skimFlag_pPAcollisionEventSelectionPA       // for pp or pA events
+};
+const char* const skimFlagNames[] = {NULL, "pcollisionEventSelection", "pPAcollisionEventSelectionPA"};
+
+/*
+ * collision system traits for the templated event loop, see GammaJetAnalyzer::loop<Traits>().
+ * A traits type fixes at compile time the centrality variable, the collision event selection and the jet collection,
+ * so that only the branches of that collision system are read and the event selection has no runtime switch.
+ * The event selection of a traits loop requires the noise filter, the collision event selection and the centrality window.
+ *
+ * names are not "pp", "pPb", "PbPb" so that they do not clash with the collision type enums of the macros.
+ */
+struct ppTraits {
+    static const int centrality = centrality_none;
+    static const int skimFlag = skimFlag_pPAcollisionEventSelectionPA;
+    static const int jet = ak3PFJets;
+    static const char* name() { return "pp"; }
+};
+
+struct pPbTraits {
+    static const int centrality = centrality_hf4sum;
+    static const int skimFlag = skimFlag_pPAcollisionEventSelectionPA;
+    static const int jet = akPu3PFJets;
+    static const char* name() { return "pPb"; }
+};
+
+struct PbPbTraits {
+    static const int centrality = centrality_hiBin;
+    static const int skimFlag = skimFlag_pcollisionEventSelection;
+    static const int jet = akPu3PFJets;
+    static const char* name() { return "PbPb"; }
+};
+
+// traits of loop() without template argument : every centrality variable is read, no skim flag is applied,
+// jets are from the tree set by setJetTree(). The event selection is the vz cut only, same as "cond_event".
+struct anyCollisionTraits {
+    static const int centrality = centrality_all;
+    static const int skimFlag = skimFlag_none;
+    static const int jet = -1;
+    static const char* name() { return "any"; }
+};
+
+// cumulative selection stages of the event loop, same as "histoSuffix" in test/test_GammaJetAnalyzer.C
+enum selectionStage {
+    sel_noSelection,    // no selection
+    sel_event,          // event selection
+    sel_eta,            // event selection + eta cut, eta cut includes photon pT cut as well
+    sel_spike,          // event selection + eta cut + spike rejection
+    sel_iso,            // event selection + eta cut + spike rejection + isolation
+    sel_purity,         // event selection + eta cut + spike rejection + isolation + purity
+    nSelections
+};
+const char* const selectionSuffix[nSelections] = {"", "_event", "_eta", "_spike", "_iso", "_purity"};
+const char* const selectionNames[nSelections]  = {"noSelection", "event", "eta", "spike", "iso", "purity"};
+
+// histograms filled by the event loop, one histogram per selection stage for each type
+enum histogramType {
+    hist_pt,
+    hist_sigmaIetaIeta,
+    hist_phi,
+    hist_pt_2nd,
+    hist_sigmaIetaIeta_2nd,
+    hist_phi_2nd,
+    hist_jetPt,
+    hist_jetPhi,
+    hist_jetPt_2nd,
+    hist_jetPhi_2nd,
+    nHistogramTypes
+};
+const char* const histogramNames[nHistogramTypes] = {"fPt", "fSigmaIetaIeta", "fPhi", "fPt_2nd", "fSigmaIetaIeta_2nd", "fPhi_2nd",
+                                                     "fJetPt", "fJetPhi", "fJetPt_2nd", "fJetPhi_2nd"};
+// jet histogram types are hist_jetPt, ..., hist_jetPhi_2nd, they are booked for every jet collection of addJetCollection()
+const int nJetHistogramTypes = hist_jetPhi_2nd - hist_jetPt + 1;
+
+// stages of the analyzer that are timed if the instrumentation is compiled in, see perfUtil.h
+enum analyzerStage {
+    stage_read,         // reading the baskets of the branches used by the event loop, includes decompression
+    stage_formula,      // TTree::Draw() calls by drawMax* functions : reading, formula evaluation and filling
+    stage_selection,    // selections and search for leading/subleading objects in the event loop
+    stage_fill,         // filling histograms in the event loop
+    nAnalyzerStages
+};
+const char* const analyzerStageNames[nAnalyzerStages] = {"read", "formula", "selection", "fill"};
+
 ////////// default cuts for event //////////
 const float vz = 15;
 const int hiBin_gt = -1;
@@ -70,6 +176,104 @@ private:
     TString deta;
     TString dR;
 
+    // trees read by the event loop
+    enum { evtIndex, skimIndex, photonIndex, jetIndex, nTreeIndices };
+    int    perfTreeIndex[nTreeIndices+1];               // index of the trees in "perf", last one is for the ak3PF jet tree
+
+    GammaJetSkimWriter* skimWriter;     // NULL if no skim is written
+
+    // histograms of the event loop
+    TH1D** histogramTable[nHistogramTypes];     // inclusive histograms : fPt, fSigmaIetaIeta, ...
+    TString histogramTag;                       // "tag" of the last bookHistograms()
+    CentralityBinning* centralityBinning;       // NULL if no centrality bins are set
+    std::vector<TH1D*> centralityHistograms;    // index is [centrality bin][histogram type][selection stage]
+
+    // I/O tuning, see setupCache()
+    bool     cacheEnabled;
+    Long64_t cacheSize;
+    int      cacheLearnEntries;
+    int      prefetchClusters;
+    ClusterPrefetcher* prefetcher;      // NULL if prefetching is disabled
+    bool     parallelUnzip;
+
+    TTree* getLoopTree(int treeIndex);
+    TreeView* getLoopView(int treeIndex);
+    const std::vector<TBranch*>& getLoopBranches(int treeIndex);
+    void setCacheForTree(int treeIndex);
+    void startPrefetcher();
+    template <class Traits> void bindBranches();
+    bool readEntry(Long64_t entry);
+    template <class Traits> bool prepareLoop();
+    template <class Traits> void processEntry(Long64_t entry, bool fillCentrality);
+    GammaJetAnalyzer* createLoopWorker();
+    template <class Traits> void selectEntry();
+    UChar_t selectPhoton(int i);
+    void selectJets(const JetCollection& jetCollection, int maxJet[], int maxJet2nd[]);
+    void selectJetCollections();
+    void bookHistogramSet(TH1D** set[], const char* suffix, int firstType = 0, int nTypes = nHistogramTypes);
+    void bookCentralityHistograms();
+    void getCentralityHistogramSet(int bin, TH1D** set[]);
+    void fillHistogramSet(TH1D** const set[], double weight = 1);
+    void fillHistograms();
+    void fillCentralityHistograms();
+    void bookMixedEventHistograms();
+    void mixEvent();
+    void bookPairHistograms();
+    void fillPairHistograms();
+    void fillCutFlow();
+
+    // additional jet collections of the event loop, see addJetCollection(). index is the collection
+    std::vector<TString>        jetAlgorithms;
+    std::vector<TTree*>         jetCollectionTrees;
+    std::vector<JetCollection*> jetCollections;         // not bound if the tree is "jetTree", the collection uses "jets" then
+    std::vector<int>            jetCollectionMaxIndex;      // index is [collection][selection stage]
+    std::vector<int>            jetCollectionMax2ndIndex;   // index is [collection][selection stage]
+    std::vector<TH1D*>          jetCollectionHistograms;    // index is [collection][jet histogram type][selection stage]
+    const JetCollection& getJetCollection(int collection) const;
+    void bookJetCollectionHistograms(int collection);
+    void fillJetCollectionHistograms();
+    void setCacheForJetCollection(int collection);
+
+    // leading photon columns, see buildLeadingPhotons()
+    TTree*  leadingPhotonTree;      // NULL if the columns are not built
+    TFile*  leadingPhotonFile;      // NULL if the columns are kept in memory
+    TString leadingPhotonConditions[nSelections];   // photon selection of each stage when the columns were built
+    Int_t   leadPhoIndex[nSelections];
+    Float_t leadPhoPt[nSelections];
+    Float_t leadPhoEta[nSelections];
+    Float_t leadPhoPhi[nSelections];
+    void    removeLeadingPhotons();
+    TString getJetCondition(TString cond, TString cond_photon, TString* photonCut);
+
+    // photon-jet pair observables of the current entry, index is the jet, see enablePairObservables()
+    bool pairObservablesEnabled;
+    std::vector<float> pair_xJ;
+    std::vector<float> pair_dphi;
+    std::vector<float> pair_deta;
+    std::vector<float> pair_dR;
+
+    // Poisson bootstrap of the event loop, see setBootstrap()
+    PoissonBootstrap*  bootstrap;               // NULL if the bootstrap is disabled
+    std::vector<float> bootstrapWeights;        // weight of each replica for the current entry
+    std::vector<TH1D*> bootstrapHistograms;     // index is [replica][histogram type][selection stage]
+    std::vector<TH1D*> bootstrapXJHistograms;   // replicas of fPair_xJ, index is [replica][selection stage]
+    void bookBootstrapHistograms();
+    void bookBootstrapXJHistograms();
+    void getBootstrapHistogramSet(int replica, TH1D** set[]);
+    void fillBootstrapHistograms();
+
+    // (run, lumi, evt) index of "evtTree", NULL if it is not built yet, see getEventIndex()
+    EventIndex* eventIndex;
+    bool duplicateRemovalEnabled;       // duplicate events are skipped by the event loop, see removeDuplicateEvents()
+
+    // checkpoints of the event loop, see setCheckpoint()
+    TString  checkpointFileName;    // empty if checkpoints are disabled
+    Long64_t checkpointInterval;
+    std::vector<TH1D*> getLoopHistograms();
+    TString  getLoopConfiguration(const char* systemName);
+    Long64_t readCheckpoint(const char* systemName, Long64_t firstEntry, Long64_t lastEntry);
+    void     writeCheckpoint(const char* systemName, Long64_t firstEntry, Long64_t nextEntry);
+
     void Constructor();         // assume "constructor delegation" is not implemented.
                                 // a constructor does not call another constructor,
                                 // but uses "Constructor()" to do the reduntant part of the object construction.
@@ -78,6 +282,9 @@ public:
     GammaJetAnalyzer(TFile* hiForestFile);
     GammaJetAnalyzer(TString hiForestFileName);
     void setJetTree(jetType jet);
+    int  addJetCollection(const char* algorithm);
+    int  getNJetCollections() const;
+    TH1D* getJetCollectionHistogram(const char* algorithm, int type, int stage);
     virtual ~GammaJetAnalyzer();
 
     // set selections/cuts
@@ -95,6 +302,35 @@ public:
     void drawMaxJet   (TString jetFormula, TString formulaForJetMax, TString cond = "1", TString cond_photon = "1", TString cut = "1", TH1* hist = NULL);
     void drawMaxJet2nd(TString jetFormula, TString formulaForJetMax, TString cond = "1", TString cond_photon = "1", TH1* hist = NULL);
     void drawMaxJet2nd(TString jetFormula, TString formulaForJetMax, TString cond = "1", TString cond_photon = "1", TString cut = "1", TH1* hist = NULL);
+    void buildLeadingPhotons(const char* outputFileName = NULL);
+
+    // event loop
+    void bookHistograms(const char* tag = "");
+    void loop(Long64_t nEntries = -1, Long64_t firstEntry = 0);
+    template <class Traits> void loop(Long64_t nEntries = -1, Long64_t firstEntry = 0);
+    void loopParallel(int nThreads, Long64_t nEntries = -1, Long64_t firstEntry = 0);
+    template <class Traits> void loopParallel(int nThreads, Long64_t nEntries = -1, Long64_t firstEntry = 0);
+    void setSkimWriter(GammaJetSkimWriter* skimWriter);
+    GammaJetSkimWriter* getSkimWriter() const;
+    void setCentralityBins(int variable, int nBins, const float binEdges[]);
+    TH1D* getCentralityHistogram(int bin, int type, int stage);
+    void setEventMixing(int depth, int nVzBins = 10, int maxJetsPerEvent = 50);
+    void enablePairObservables();
+    void setBootstrap(int nReplicas, ULong64_t seed = 0);
+    TH1D* getBootstrapHistogram(int replica, int type, int stage);
+    TH1D* getBootstrapXJHistogram(int replica, int stage);
+    void setCheckpoint(const char* fileName, Long64_t interval = 100000);
+    // duplicate events and event lookup
+    EventIndex* getEventIndex(const char* indexFileName = NULL);
+    void     removeDuplicateEvents(bool remove = true);
+    Long64_t readEvent(Int_t run, Int_t lumi, Int_t evt);
+    // I/O tuning
+    void setupCache(Long64_t cacheSize = -1, int learnEntries = 100, bool prefetch = false, int prefetchClusters = 2);
+    void setParallelUnzip(int nThreads);
+    // instrumentation, has effect only if compiled with HIUTILS_PERF
+    void enablePerfStats();
+    void printPerfStats();
+    void writePerfStats(TDirectory* dir);
 
     // merge cuts
     static TString mergeSelections(TString sel1, TString sel2);
@@ -107,8 +343,53 @@ public:
     TTree* skimTree;
     TTree* photonTree;
     TTree* jetTree;
+    // views of the current entry of the event loop, bound once by the loop and reused for every entry
+    EventInfo        event;
+    SkimFlags        skim;
+    PhotonCollection photons;
+    JetCollection    jets;
     // Histograms
     TH1D* h;
+    // histograms filled by loop(), index is the selection stage
+    TH1D* fPt[nSelections];
+    TH1D* fSigmaIetaIeta[nSelections];
+    TH1D* fPhi[nSelections];
+    TH1D* fPt_2nd[nSelections];
+    TH1D* fSigmaIetaIeta_2nd[nSelections];
+    TH1D* fPhi_2nd[nSelections];
+    TH1D* fJetPt[nSelections];
+    TH1D* fJetPhi[nSelections];
+    TH1D* fJetPt_2nd[nSelections];
+    TH1D* fJetPhi_2nd[nSelections];
+    // leading jet of the mixed events for the leading photon, weighted by 1 / number of mixed events, see setEventMixing()
+    TH1D* fJetPt_mix[nSelections];
+    TH1D* fJetPhi_mix[nSelections];
+
+    // photon-jet pairs of the leading photon with every jet that passes the jet selection, see enablePairObservables()
+    TH1D* fPair_jetPt[nSelections];
+    TH1D* fPair_xJ[nSelections];
+    TH1D* fPair_dphi[nSelections];
+    TH1D* fPair_deta[nSelections];
+    TH1D* fPair_dR[nSelections];
+
+    // pools of the event mixing, NULL if event mixing is disabled
+    MixedEventPool* mixedEventPool;
+
+    // result of the selections for the current entry of the event loop, index is the selection stage
+    // indices are -1 if there is no such object
+    int maxPhotonIndex[nSelections];
+    int maxPhoton2ndIndex[nSelections];
+    int maxJetIndex[nSelections];
+    int maxJet2ndIndex[nSelections];
+    bool eventPassed[nSelections];          // event has passed the selection stage, for photon stages at least one photon passed
+    int  nPhotonsPassed[nSelections];       // number of photons that passed the selection stage
+
+    // event and photon counts per selection stage, filled by loop()
+    CutFlow* cutFlow;
+    double   eventWeight;       // weight of the events in the cut flow, default is 1
+
+    // instrumentation, NULL unless enablePerfStats() is called
+    PerfStats* perf;
 
     ////////// cuts for event //////////
     float cut_vz;                               // evtTree
@@ -0,0 +1,285 @@
+/*
+ * GammaJetSkimWriter.h
+ *
+ * class to write a compact, flat tree with one entry per event from the event loop of GammaJetAnalyzer.
+ * The tree holds the event variables and the leading/subleading photons and jets of every selection stage,
+ * so that later passes can reproduce the histograms of the event loop without reading the HiForest.
+ *
+ * A photon or jet that is leading/subleading for several stages is stored once :
+ *  - "phoLead[k]" and "phoSublead[k]" are the indices in the "pho*" arrays of the leading and subleading photon
+ *    for selection stage k, -1 if there is no such photon. "jetLead[k]" and "jetSublead[k]" likewise.
+ *  - bit k of "phoStages[i]" is set if photon i passed selection stage k, "eventStages" likewise for the event.
+ *  - "phoIndex" and "jetIndex" are the indices of the objects in the HiForest.
+ *
+ * usage :
+ *  GammaJetSkimWriter* skim = new GammaJetSkimWriter(gja, "skim.root");
+ *  skim->addColumn("hiNpix", "hiNpix");
+ *  gja->setSkimWriter(skim);
+ *  gja->loop();
+ *  skim->write();      // detaches the writer from the analyzer, later loops do not write to the skim
+ *  delete skim;        // before the analyzer
+ */
+
+#ifndef GAMMAJETSKIMWRITER_H_
+#define GAMMAJETSKIMWRITER_H_
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeFormula.h>
+#include <TString.h>
+
+#include <vector>
+#include <iostream>
+
+#include "GammaJetAnalyzer.h"
+#include "treeUtil.h"
+
+class GammaJetSkimWriter {
+public:
+    GammaJetSkimWriter(GammaJetAnalyzer* analyzer, const char* outputFileName, int compressionSettings = 505);
+    virtual ~GammaJetSkimWriter();
+
+    void addColumn(const char* name, const char* formula);
+    void setMinimumStage(int stage);
+    void setParallelWriting(int nThreads);
+    void fill(Long64_t entry);
+    void write();
+
+    TFile* outputFile;      // NULL once the skim is written
+    TTree* skimTree;        // NULL once the skim is written, it is deleted with the file
+
+private:
+    static const int maxObjects = 2 * nSelections;      // leading and subleading object for each stage
+
+    int  addPhoton(int i);
+    int  addJet(int i);
+
+    GammaJetAnalyzer* analyzer;
+    int minimumStage;
+
+    // extra columns, evaluated from the HiForest by TTreeFormula
+    std::vector<TTreeFormula*> columnFormulas;
+    std::vector<Float_t*>      columnValues;
+
+    Int_t   run;
+    Int_t   evt;
+    Int_t   lumi;
+    Float_t vz;
+    Int_t   hiBin;
+    Float_t hf4sum;
+    UChar_t eventStages;
+
+    Int_t   nPho;
+    Int_t   phoIndex[maxObjects];
+    Float_t phoPt[maxObjects];
+    Float_t phoEta[maxObjects];
+    Float_t phoPhi[maxObjects];
+    Float_t phoSigmaIetaIeta[maxObjects];
+    UChar_t phoStages[maxObjects];
+    Int_t   phoLead[nSelections];
+    Int_t   phoSublead[nSelections];
+
+    Int_t   nJet;
+    Int_t   jetIndex[maxObjects];
+    Float_t jetPt[maxObjects];
+    Float_t jetEta[maxObjects];
+    Float_t jetPhi[maxObjects];
+    Int_t   jetLead[nSelections];
+    Int_t   jetSublead[nSelections];
+};
+
+/*
+ * compressionSettings = 100 * algorithm + level, default is ZSTD with level 5 which decompresses fast.
+ * Use e.g. 207 (LZMA, level 7) for the smallest files.
+ *
+ * https://root.cern.ch/doc/master/structROOT_1_1RCompressionSetting.html
+ */
+GammaJetSkimWriter::GammaJetSkimWriter(GammaJetAnalyzer* analyzer, const char* outputFileName, int compressionSettings)
+{
+    this->analyzer = analyzer;
+    minimumStage = sel_noSelection;
+
+    // histograms booked after the writer must not be attached to the skim file
+    TDirectory* currentDirectory = gDirectory;
+    outputFile = new TFile(outputFileName, "RECREATE", "", compressionSettings);
+    currentDirectory->cd();
+    skimTree = new TTree("gammaJetSkim", "leading photons and jets for each selection stage");
+    skimTree->SetDirectory(outputFile);
+
+    skimTree->Branch("run", &run, "run/I");
+    skimTree->Branch("evt", &evt, "evt/I");
+    skimTree->Branch("lumi", &lumi, "lumi/I");
+    skimTree->Branch("vz", &vz, "vz/F");
+    skimTree->Branch("hiBin", &hiBin, "hiBin/I");
+    skimTree->Branch("hf4sum", &hf4sum, "hf4sum/F");
+    skimTree->Branch("eventStages", &eventStages, "eventStages/b");
+
+    skimTree->Branch("nPho", &nPho, "nPho/I");
+    skimTree->Branch("phoIndex", phoIndex, "phoIndex[nPho]/I");
+    skimTree->Branch("phoPt", phoPt, "phoPt[nPho]/F");
+    skimTree->Branch("phoEta", phoEta, "phoEta[nPho]/F");
+    skimTree->Branch("phoPhi", phoPhi, "phoPhi[nPho]/F");
+    skimTree->Branch("phoSigmaIetaIeta", phoSigmaIetaIeta, "phoSigmaIetaIeta[nPho]/F");
+    skimTree->Branch("phoStages", phoStages, "phoStages[nPho]/b");
+    skimTree->Branch("phoLead", phoLead, Form("phoLead[%d]/I", nSelections));
+    skimTree->Branch("phoSublead", phoSublead, Form("phoSublead[%d]/I", nSelections));
+
+    skimTree->Branch("nJet", &nJet, "nJet/I");
+    skimTree->Branch("jetIndex", jetIndex, "jetIndex[nJet]/I");
+    skimTree->Branch("jetPt", jetPt, "jetPt[nJet]/F");
+    skimTree->Branch("jetEta", jetEta, "jetEta[nJet]/F");
+    skimTree->Branch("jetPhi", jetPhi, "jetPhi[nJet]/F");
+    skimTree->Branch("jetLead", jetLead, Form("jetLead[%d]/I", nSelections));
+    skimTree->Branch("jetSublead", jetSublead, Form("jetSublead[%d]/I", nSelections));
+}
+
+/*
+ * closes the output file if the skim is not written. must be deleted before the analyzer.
+ */
+GammaJetSkimWriter::~GammaJetSkimWriter()
+{
+    if (analyzer->getSkimWriter() == this)  analyzer->setSkimWriter(NULL);
+    delete outputFile;
+
+    for (unsigned i = 0; i < columnFormulas.size(); ++i) {
+        delete columnFormulas[i];
+        delete columnValues[i];
+    }
+}
+
+/*
+ * add a column "name" whose value is "formula" evaluated on the HiForest, e.g. "hiNpix" or "Sum$(jtpt > 30)".
+ * For formulas with several elements the first element is written. must be called before the event loop.
+ */
+void GammaJetSkimWriter::addColumn(const char* name, const char* formula)
+{
+    TTreeFormula* treeFormula = new TTreeFormula(name, formula, analyzer->tree);
+    if (treeFormula->GetNdim() == 0) {
+        std::cout << "GammaJetSkimWriter : formula " << formula << " is not valid, column " << name << " is not added." << std::endl;
+        delete treeFormula;
+        return;
+    }
+
+    Float_t* value = new Float_t;
+    columnFormulas.push_back(treeFormula);
+    columnValues.push_back(value);
+    skimTree->Branch(name, value, Form("%s/F", name));
+}
+
+/*
+ * write only the events that passed selection stage "stage", default is to write every event.
+ * Cut flow is written to the skim as well, so the counts of the events that are not written are not lost.
+ */
+void GammaJetSkimWriter::setMinimumStage(int stage)
+{
+    minimumStage = stage;
+}
+
+/*
+ * compress the baskets of the skim in parallel, using ROOT's implicit multithreading with "nThreads" threads.
+ * nThreads <= 0 uses all cores.
+ */
+void GammaJetSkimWriter::setParallelWriting(int nThreads)
+{
+    setImplicitMTPoolSize(nThreads);
+    skimTree->SetImplicitMT(kTRUE);
+}
+
+/*
+ * write the current entry of the event loop. called by GammaJetAnalyzer::loop() after the selections.
+ */
+void GammaJetSkimWriter::fill(Long64_t entry)
+{
+    if (skimTree == NULL)  return;
+    if (!analyzer->eventPassed[minimumStage])  return;
+
+    run  = analyzer->event.run;
+    evt  = analyzer->event.evt;
+    lumi = analyzer->event.lumi;
+    vz   = analyzer->event.vz;
+    hiBin  = analyzer->event.hiBin;
+    hf4sum = analyzer->event.hf4sum();
+
+    eventStages = 0;
+    nPho = 0;
+    nJet = 0;
+    for (int k = 0; k < nSelections; ++k) {
+        if (analyzer->eventPassed[k])  eventStages |= (1 << k);
+
+        phoLead[k]    = addPhoton(analyzer->maxPhotonIndex[k]);
+        phoSublead[k] = addPhoton(analyzer->maxPhoton2ndIndex[k]);
+        jetLead[k]    = addJet(analyzer->maxJetIndex[k]);
+        jetSublead[k] = addJet(analyzer->maxJet2ndIndex[k]);
+    }
+
+    if (!columnFormulas.empty()) {
+        // the event loop reads the branches directly, the formulas need the friend trees to be at the same entry
+        analyzer->tree->LoadTree(entry);
+        for (unsigned i = 0; i < columnFormulas.size(); ++i) {
+            *columnValues[i] = (columnFormulas[i]->GetNdata() > 0) ? columnFormulas[i]->EvalInstance(0) : 0;
+        }
+    }
+
+    skimTree->Fill();
+}
+
+/*
+ * write the skim and the cut flow of the analyzer, then close and delete the output file.
+ * The writer is detached from the analyzer, fill() does nothing afterwards.
+ */
+void GammaJetSkimWriter::write()
+{
+    if (outputFile == NULL)  return;
+    if (analyzer->getSkimWriter() == this)  analyzer->setSkimWriter(NULL);
+
+    TDirectory* currentDirectory = gDirectory;
+    outputFile->cd();
+    skimTree->Write("", TObject::kOverwrite);
+    analyzer->cutFlow->write(outputFile);
+    outputFile->Close();
+    if (currentDirectory != outputFile)  currentDirectory->cd();
+
+    delete outputFile;
+    outputFile = NULL;
+    skimTree = NULL;
+}
+
+/*
+ * add photon "i" of the HiForest to the skim if it is not added yet. returns its index in the skim, -1 if i < 0.
+ */
+int GammaJetSkimWriter::addPhoton(int i)
+{
+    if (i < 0)  return -1;
+
+    for (int j = 0; j < nPho; ++j) {
+        if (phoIndex[j] == i)  return j;
+    }
+
+    phoIndex[nPho] = i;
+    phoPt[nPho]  = analyzer->photons.pt[i];
+    phoEta[nPho] = analyzer->photons.eta[i];
+    phoPhi[nPho] = analyzer->photons.phi[i];
+    phoSigmaIetaIeta[nPho] = analyzer->photons.sigmaIetaIeta[i];
+    phoStages[nPho] = analyzer->photons.stages[i];
+    return nPho++;
+}
+
+/*
+ * add jet "i" of the HiForest to the skim if it is not added yet. returns its index in the skim, -1 if i < 0.
+ */
+int GammaJetSkimWriter::addJet(int i)
+{
+    if (i < 0)  return -1;
+
+    for (int j = 0; j < nJet; ++j) {
+        if (jetIndex[j] == i)  return j;
+    }
+
+    jetIndex[nJet] = i;
+    jetPt[nJet]  = analyzer->jets.pt[i];
+    jetEta[nJet] = analyzer->jets.eta[i];
+    jetPhi[nJet] = analyzer->jets.phi[i];
+    return nJet++;
+}
+
+#endif /* GAMMAJETSKIMWRITER_H_ */
@@ -0,0 +1,244 @@
+/*
+ * MixedEventPool.h
+ *
+ * class to keep the jets of the last events of each event class for event mixing.
+ * Event classes are bins of vz and, optionally, of centrality (see CentralityBinning).
+ *
+ * Every class has a ring buffer of "depth" events, each event holds at most "maxJetsPerEvent" jets as compact records.
+ * All the memory is allocated in the constructor, so memory use depends on the configuration but not on the number of
+ * events : nClasses * depth * maxJetsPerEvent * sizeof(mixedJet), see getMemoryUsage().
+ */
+
+#ifndef MIXEDEVENTPOOL_H_
+#define MIXEDEVENTPOOL_H_
+
+#include <TMath.h>
+#include <TDirectory.h>
+
+#include <vector>
+#include <iostream>
+
+#include "CentralityBinning.h"
+
+// compact jet record stored in the pools
+struct mixedJet {
+    Float_t pt;
+    Float_t eta;
+    Float_t phi;
+};
+
+class MixedEventPool {
+public:
+    MixedEventPool(int depth, int maxJetsPerEvent, int nVzBins, float vzMax, const CentralityBinning* centralityBinning = NULL);
+    MixedEventPool(const MixedEventPool& other);
+    virtual ~MixedEventPool();
+
+    int  getClass(float vz, float centrality = 0) const;
+    void addEvent(int eventClass, int nJets, const Float_t* pt, const Float_t* eta, const Float_t* phi, float minPt, float maxAbsEta);
+    int  getNEvents(int eventClass) const;
+    int  getNJets(int eventClass, int i) const;
+    const mixedJet* getJets(int eventClass, int i) const;
+
+    int    getDepth() const;
+    int    getNClasses() const;
+    int    getCentralityVariable() const;
+    size_t getMemoryUsage() const;
+    void   reset();
+    void   saveState(TDirectory* dir) const;
+    bool   loadState(TDirectory* dir);
+
+private:
+    int   depth;
+    int   maxJetsPerEvent;
+    int   nVzBins;
+    float vzMax;
+    CentralityBinning* centralityBinning;   // NULL if classes are not binned in centrality
+
+    std::vector<mixedJet> jets;     // index is [class][slot][jet]
+    std::vector<int>      nJets;    // index is [class][slot]
+    std::vector<int>      next;     // slot to be overwritten next, for each class
+    std::vector<int>      nEvents;  // number of filled slots, for each class
+};
+
+/*
+ * "nVzBins" uniform bins in [-vzMax, vzMax]. Centrality classes are the bins of "centralityBinning", which is copied.
+ */
+MixedEventPool::MixedEventPool(int depth, int maxJetsPerEvent, int nVzBins, float vzMax, const CentralityBinning* centralityBinning)
+{
+    this->depth = TMath::Max(depth, 1);
+    this->maxJetsPerEvent = TMath::Max(maxJetsPerEvent, 1);
+    this->nVzBins = TMath::Max(nVzBins, 1);
+    this->vzMax = vzMax;
+    this->centralityBinning = (centralityBinning != NULL) ? new CentralityBinning(*centralityBinning) : NULL;
+
+    const int nClasses = getNClasses();
+    jets.resize((size_t)nClasses * this->depth * this->maxJetsPerEvent);
+    nJets.assign(nClasses * this->depth, 0);
+    next.assign(nClasses, 0);
+    nEvents.assign(nClasses, 0);
+}
+
+/*
+ * copy of the pools, the centrality binning is copied as well
+ */
+MixedEventPool::MixedEventPool(const MixedEventPool& other) :
+    depth(other.depth), maxJetsPerEvent(other.maxJetsPerEvent), nVzBins(other.nVzBins), vzMax(other.vzMax),
+    jets(other.jets), nJets(other.nJets), next(other.next), nEvents(other.nEvents)
+{
+    centralityBinning = (other.centralityBinning != NULL) ? new CentralityBinning(*other.centralityBinning) : NULL;
+}
+
+MixedEventPool::~MixedEventPool()
+{
+    delete centralityBinning;
+}
+
+/*
+ * class of an event with "vz" and "centrality" (hiBin or hf4sum), -1 if the event is outside the classes
+ */
+int MixedEventPool::getClass(float vz, float centrality) const
+{
+    if (vz < -vzMax || vz >= vzMax)  return -1;
+    int vzBin = TMath::Min((int)((vz + vzMax) / (2 * vzMax) * nVzBins), nVzBins - 1);
+
+    int centralityBin = 0;
+    if (centralityBinning != NULL) {
+        centralityBin = centralityBinning->getBin(centrality);
+        if (centralityBin < 0)  return -1;
+    }
+    return centralityBin * nVzBins + vzBin;
+}
+
+/*
+ * store the jets with pT > minPt and |eta| < maxAbsEta of an event into the pool of "eventClass",
+ * replacing the oldest event if the pool is full. Jets after the first "maxJetsPerEvent" stored jets are dropped.
+ */
+void MixedEventPool::addEvent(int eventClass, int nJets, const Float_t* pt, const Float_t* eta, const Float_t* phi, float minPt, float maxAbsEta)
+{
+    const int slot = eventClass * depth + next[eventClass];
+    mixedJet* stored = &jets[(size_t)slot * maxJetsPerEvent];
+
+    int n = 0;
+    for (int i = 0; i < nJets && n < maxJetsPerEvent; ++i) {
+        if (pt[i] <= minPt || TMath::Abs(eta[i]) >= maxAbsEta)  continue;
+
+        stored[n].pt  = pt[i];
+        stored[n].eta = eta[i];
+        stored[n].phi = phi[i];
+        ++n;
+    }
+    this->nJets[slot] = n;
+
+    next[eventClass] = (next[eventClass] + 1) % depth;
+    if (nEvents[eventClass] < depth)  nEvents[eventClass]++;
+}
+
+/*
+ * number of events stored in the pool of "eventClass", at most "depth"
+ */
+int MixedEventPool::getNEvents(int eventClass) const
+{
+    return nEvents[eventClass];
+}
+
+int MixedEventPool::getNJets(int eventClass, int i) const
+{
+    return nJets[eventClass * depth + i];
+}
+
+/*
+ * jets of the "i"th stored event of "eventClass", 0 <= i < getNEvents(eventClass)
+ */
+const mixedJet* MixedEventPool::getJets(int eventClass, int i) const
+{
+    return &jets[((size_t)eventClass * depth + i) * maxJetsPerEvent];
+}
+
+int MixedEventPool::getDepth() const
+{
+    return depth;
+}
+
+int MixedEventPool::getNClasses() const
+{
+    int nCentralityBins = (centralityBinning != NULL) ? centralityBinning->getNBins() : 1;
+    return nCentralityBins * nVzBins;
+}
+
+int MixedEventPool::getCentralityVariable() const
+{
+    return (centralityBinning != NULL) ? centralityBinning->getVariable() : centrality_none;
+}
+
+/*
+ * memory used by the pools in bytes
+ */
+size_t MixedEventPool::getMemoryUsage() const
+{
+    return jets.size() * sizeof(mixedJet) + (nJets.size() + next.size() + nEvents.size()) * sizeof(int);
+}
+
+void MixedEventPool::reset()
+{
+    nJets.assign(nJets.size(), 0);
+    next.assign(next.size(), 0);
+    nEvents.assign(nEvents.size(), 0);
+}
+
+/*
+ * write the stored events into "dir", so that loadState() restores the pools exactly, e.g. for checkpoints of an event loop
+ */
+void MixedEventPool::saveState(TDirectory* dir) const
+{
+    std::vector<float> values(jets.size() * 3);
+    for (size_t i = 0; i < jets.size(); ++i) {
+        values[3*i]   = jets[i].pt;
+        values[3*i+1] = jets[i].eta;
+        values[3*i+2] = jets[i].phi;
+    }
+    dir->WriteObject(&values, "mixedEventPool_jets");
+    dir->WriteObject(&nJets, "mixedEventPool_nJets");
+    dir->WriteObject(&next, "mixedEventPool_next");
+    dir->WriteObject(&nEvents, "mixedEventPool_nEvents");
+}
+
+/*
+ * replace the stored events by the ones written by saveState() into "dir".
+ * Returns false and keeps the pools if "dir" does not have pools of the same configuration.
+ */
+bool MixedEventPool::loadState(TDirectory* dir)
+{
+    std::vector<float>* savedJets = NULL;
+    std::vector<int>*   savedNJets = NULL;
+    std::vector<int>*   savedNext = NULL;
+    std::vector<int>*   savedNEvents = NULL;
+    dir->GetObject("mixedEventPool_jets", savedJets);
+    dir->GetObject("mixedEventPool_nJets", savedNJets);
+    dir->GetObject("mixedEventPool_next", savedNext);
+    dir->GetObject("mixedEventPool_nEvents", savedNEvents);
+
+    bool found = savedJets != NULL && savedNJets != NULL && savedNext != NULL && savedNEvents != NULL &&
+                 savedJets->size() == jets.size() * 3 && savedNJets->size() == nJets.size() &&
+                 savedNext->size() == next.size() && savedNEvents->size() == nEvents.size();
+    if (found) {
+        for (size_t i = 0; i < jets.size(); ++i) {
+            jets[i].pt  = (*savedJets)[3*i];
+            jets[i].eta = (*savedJets)[3*i+1];
+            jets[i].phi = (*savedJets)[3*i+2];
+        }
+        nJets = *savedNJets;
+        next = *savedNext;
+        nEvents = *savedNEvents;
+    }
+    else {
+        std::cout << "MixedEventPool : " << dir->GetName() << " has no pools of the same configuration. Pools are not changed." << std::endl;
+    }
+
+    delete savedJets;
+    delete savedNJets;
+    delete savedNext;
+    delete savedNEvents;
+    return found;
+}
+
+#endif /* MIXEDEVENTPOOL_H_ */
@@ -0,0 +1,271 @@
+/*
+ * OutputWriter.h
+ *
+ * class to write the output objects of an analysis, e.g. histograms, into a ROOT file on a background thread.
+ *
+ * write() copies the object in the calling thread and returns, the copy is serialized, compressed and written by the
+ * background thread. The caller does not wait for the I/O and can continue to fill the histograms.
+ * Objects are written into the directory given by a path, e.g. "centrality/hiBin0_20", directories are created as needed,
+ * so the directory structure of the output is kept, unlike saveAllHistogramsToFile().
+ * An object written again with the same path and name replaces the previous one, so intermediate results can be written
+ * while processing continues. flush() waits until the queued objects are written and makes them readable in the file.
+ *
+ * compressionSettings = 100 * algorithm + level, same as for TFile, e.g.
+ *  404 : LZ4 level 4, fast, for scratch files that are read again soon
+ *  505 : ZSTD level 5
+ *  209 : LZMA level 9, small, for archival
+ * https://root.cern.ch/doc/master/structROOT_1_1RCompressionSetting.html
+ *
+ * A TFile has a single writer, so the objects of one file are compressed one after the other by its thread.
+ * Several OutputWriter objects write their files in parallel.
+ * Trees are not copied, they are written by the file they are attached to, see GammaJetSkimWriter.h.
+ *
+ * usage :
+ *  OutputWriter writer("output.root", 404);
+ *  writer.write(hPt, "photon");
+ *  writer.flush();     // intermediate result
+ *  ...
+ *  writer.close();
+ */
+
+#ifndef OUTPUTWRITER_H_
+#define OUTPUTWRITER_H_
+
+#include <TFile.h>
+#include <TDirectory.h>
+#include <TList.h>
+#include <TH1.h>
+#include <TString.h>
+#include <TROOT.h>
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <cstring>
+
+#include "histoUtil.h"
+
+// object queued for the background thread, a NULL object is a flush request
+struct outputObject {
+    TObject* obj;
+    TString  dirPath;
+};
+
+class OutputWriter {
+public:
+    OutputWriter(const char* fileName, int compressionSettings = 505);
+    virtual ~OutputWriter();
+
+    void write(const TObject* obj, const char* dirPath = "");
+    void write(TList* objects, const char* dirPath = "");
+    void writeDirectory(TDirectory* dir, const char* dirPath = "");
+    void flush();
+    void close();
+    bool isOpen() const;
+    int  getNPending();
+
+private:
+    void enqueue(TObject* obj, const char* dirPath);
+    void run();
+    void writeObject(const outputObject& object);
+
+    TFile* file;        // NULL if the writer is closed
+    std::thread thread;
+    std::mutex  mutex;
+    std::condition_variable queueCondition;     // new objects or closing, for the thread
+    std::condition_variable doneCondition;      // an object is written, for flush()
+    std::deque<outputObject> queue;
+    int  nPending;      // objects that are queued or being written
+    bool closing;
+};
+
+OutputWriter::OutputWriter(const char* fileName, int compressionSettings)
+{
+    nPending = 0;
+    closing = false;
+
+    // the background thread does I/O while the calling thread may read other files
+    ROOT::EnableThreadSafety();
+
+    TDirectory* currentDirectory = gDirectory;
+    file = new TFile(fileName, "RECREATE", "", compressionSettings);
+    currentDirectory->cd();
+    if (file->IsZombie()) {
+        std::cout << "OutputWriter : " << fileName << " cannot be created, nothing will be written." << std::endl;
+        delete file;
+        file = NULL;
+        return;
+    }
+
+    thread = std::thread(&OutputWriter::run, this);
+}
+
+OutputWriter::~OutputWriter()
+{
+    close();
+}
+
+/*
+ * write a copy of "obj" into directory "dirPath" of the file, e.g. "photon/centrality", "" is the top directory.
+ * The object can be changed or deleted after this call.
+ */
+void OutputWriter::write(const TObject* obj, const char* dirPath)
+{
+    if (obj == NULL)  return;
+    if (obj->InheritsFrom("TTree")) {
+        std::cout << "OutputWriter : " << obj->GetName() << " is a tree, trees are written by the file they are attached to." << std::endl;
+        return;
+    }
+
+    TObject* copy = obj->Clone();
+    // the copy belongs to the background thread, it must not be in a directory of the calling thread
+    if (copy->InheritsFrom("TH1"))  ((TH1*)copy)->SetDirectory(0);
+    enqueue(copy, dirPath);
+}
+
+/*
+ * write a copy of every object in "objects" into directory "dirPath".
+ * If "dirPath" is empty, histograms that are in a directory of a file are written into the directory of the same path,
+ * e.g. the histograms of getListOfALLHistograms() keep their directory structure.
+ */
+void OutputWriter::write(TList* objects, const char* dirPath)
+{
+    TIter iter(objects);
+    TObject* obj;
+    while ((obj = iter.Next())) {
+        TString path = dirPath;
+        if (path.Length() == 0 && obj->InheritsFrom("TH1")) {
+            path = getDirectoryPath(((TH1*)obj)->GetDirectory()).c_str();
+        }
+        write(obj, path.Data());
+    }
+}
+
+/*
+ * write a copy of the objects in memory in "dir" and in its subdirectories, e.g. the histograms booked in "dir",
+ * into directory "dirPath" and subdirectories of the same names
+ */
+void OutputWriter::writeDirectory(TDirectory* dir, const char* dirPath)
+{
+    TIter iter(dir->GetList());
+    TObject* obj;
+    while ((obj = iter.Next())) {
+        if (obj->InheritsFrom("TDirectory")) {
+            TString subdirPath = (strlen(dirPath) > 0) ? Form("%s/%s", dirPath, obj->GetName()) : obj->GetName();
+            writeDirectory((TDirectory*)obj, subdirPath.Data());
+        }
+        else {
+            write(obj, dirPath);
+        }
+    }
+}
+
+/*
+ * wait until every object written so far is in the file, then save the directories of the file,
+ * so that the file can be read while the processing continues
+ */
+void OutputWriter::flush()
+{
+    if (file == NULL)  return;
+
+    enqueue(NULL, "");
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return nPending == 0; });
+}
+
+/*
+ * write the queued objects and close the file, the writer cannot be used afterwards
+ */
+void OutputWriter::close()
+{
+    if (file == NULL)  return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    queueCondition.notify_one();
+    thread.join();
+
+    file->Close();
+    delete file;
+    file = NULL;
+}
+
+bool OutputWriter::isOpen() const
+{
+    return file != NULL;
+}
+
+/*
+ * number of objects that are not written yet
+ */
+int OutputWriter::getNPending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nPending;
+}
+
+void OutputWriter::enqueue(TObject* obj, const char* dirPath)
+{
+    if (file == NULL) {
+        delete obj;
+        return;
+    }
+
+    outputObject object;
+    object.obj = obj;
+    object.dirPath = dirPath;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(object);
+        ++nPending;
+    }
+    queueCondition.notify_one();
+}
+
+void OutputWriter::run()
+{
+    while (true)
+    {
+        outputObject object;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueCondition.wait(lock, [this] { return !queue.empty() || closing; });
+            // objects queued before close() are written
+            if (queue.empty())  break;
+            object = queue.front();
+            queue.pop_front();
+        }
+
+        writeObject(object);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --nPending;
+        }
+        doneCondition.notify_all();
+    }
+}
+
+/*
+ * serialize, compress and write an object, called by the background thread only
+ */
+void OutputWriter::writeObject(const outputObject& object)
+{
+    if (object.obj == NULL) {
+        // keys of every directory and the file header are written, older cycles are already deleted
+        file->Write();
+        file->Flush();
+        return;
+    }
+
+    TDirectory* dir = makeDirectory(file, object.dirPath.Data());
+    // "WriteDelete" deletes the previous cycle of the object, i.e. the last intermediate result
+    dir->WriteTObject(object.obj, object.obj->GetName(), "WriteDelete");
+    delete object.obj;
+}
+
+#endif /* OUTPUTWRITER_H_ */
@@ -0,0 +1,137 @@
+/*
+ * PoissonBootstrap.h
+ *
+ * class to generate the weights of a Poisson bootstrap : every event gets a weight drawn from Poisson(1) for each of
+ * "nReplicas" replicas. Histograms filled with the weights of a replica are a resample of the data, the spread of a derived
+ * quantity over the replicas, e.g. a ratio of histograms or a mean xJ, is its statistical uncertainty.
+ * All replicas are filled in the same pass over the events, see GammaJetAnalyzer::setBootstrap().
+ *
+ * The weights come from a counter-based generator : weight "r" of an event is a keyed hash of the counter "r", the key is
+ * the event (see EventIndex::hash()) and the seed. There is no state between events, so the weights of an event do not
+ * depend on the order of the entries, on the file the event is in or on the thread that processes it.
+ * The hash is made of 32 bit integer multiplications, shifts and xors, and the Poisson variate is the number of thresholds
+ * of the cumulative distribution below the uniform variate, without branches. So generate() makes the weights of every
+ * replica in one loop that the compiler vectorizes.
+ * Weights are at most "nThresholds", the probability of a larger Poisson(1) variate is below 1e-9.
+ *
+ * usage :
+ *  PoissonBootstrap bootstrap(100);
+ *  std::vector<float> weights(bootstrap.getNReplicas());
+ *  bootstrap.generate(EventIndex::hash(run, lumi, evt), &weights[0]);
+ *  for (int r = 0; r < bootstrap.getNReplicas(); ++r)  hReplicas[r]->Fill(x, weights[r]);
+ *  ...
+ *  PoissonBootstrap::setBinErrors(hRatio, nReplicas, hRatioReplicas);
+ */
+
+#ifndef POISSONBOOTSTRAP_H_
+#define POISSONBOOTSTRAP_H_
+
+#include <TH1.h>
+#include <TMath.h>
+
+#include <vector>
+
+class PoissonBootstrap {
+public:
+    PoissonBootstrap(int nReplicas, ULong64_t seed = 0);
+    virtual ~PoissonBootstrap();
+
+    void      generate(ULong64_t eventKey, float* weights) const;
+    int       getNReplicas() const;
+    ULong64_t getSeed() const;
+    static void setBinErrors(TH1* hist, int nReplicas, TH1* const replicas[]);
+
+private:
+    static const int nThresholds = 12;
+
+    static UInt_t mix32(UInt_t x);
+
+    int       nReplicas;
+    ULong64_t seed;
+    UInt_t    thresholds[nThresholds];    // P(X <= k) for X ~ Poisson(1) in units of 2^-32, index is k
+};
+
+PoissonBootstrap::PoissonBootstrap(int nReplicas, ULong64_t seed)
+{
+    this->nReplicas = TMath::Max(nReplicas, 1);
+    this->seed = seed;
+
+    double probability = TMath::Exp(-1);
+    double cumulative = 0;
+    for (int k = 0; k < nThresholds; ++k) {
+        cumulative += probability;
+        probability /= (k + 1);
+        thresholds[k] = (UInt_t)TMath::Min(cumulative * 4294967296., 4294967295.);
+    }
+}
+
+PoissonBootstrap::~PoissonBootstrap()
+{
+}
+
+/*
+ * Poisson(1) weight of each replica for the event "eventKey", weights must have getNReplicas() elements.
+ * The same event and seed give the same weights.
+ */
+void PoissonBootstrap::generate(ULong64_t eventKey, float* weights) const
+{
+    // the seed changes every bit of the key
+    const ULong64_t key = eventKey ^ (seed * 0x9E3779B97F4A7C15ULL);
+    const UInt_t key0 = mix32((UInt_t)key);
+    const UInt_t key1 = (UInt_t)(key >> 32);
+
+    for (int r = 0; r < nReplicas; ++r) {
+        UInt_t u = mix32(key0 ^ mix32(key1 + (UInt_t)r * 0x9E3779B9u));
+        int n = 0;
+        for (int k = 0; k < nThresholds; ++k)  n += (u >= thresholds[k]);
+        weights[r] = n;
+    }
+}
+
+int PoissonBootstrap::getNReplicas() const
+{
+    return nReplicas;
+}
+
+ULong64_t PoissonBootstrap::getSeed() const
+{
+    return seed;
+}
+
+/*
+ * set the error of every bin of "hist" to the standard deviation of the bin over the "nReplicas" replicas,
+ * e.g. for a ratio of histograms whose numerator and denominator were filled with the same bootstrap weights.
+ */
+void PoissonBootstrap::setBinErrors(TH1* hist, int nReplicas, TH1* const replicas[])
+{
+    if (nReplicas < 2)  return;
+
+    const int nCells = hist->GetNcells();
+    for (int bin = 0; bin < nCells; ++bin) {
+        double sum = 0;
+        double sum2 = 0;
+        for (int r = 0; r < nReplicas; ++r) {
+            double content = replicas[r]->GetBinContent(bin);
+            sum += content;
+            sum2 += content * content;
+        }
+        double mean = sum / nReplicas;
+        double variance = (sum2 - nReplicas * mean * mean) / (nReplicas - 1);
+        hist->SetBinError(bin, TMath::Sqrt(TMath::Max(variance, 0.)));
+    }
+}
+
+/*
+ * bijective 32 bit integer hash ("lowbias32" by C. Wellons)
+ */
+UInt_t PoissonBootstrap::mix32(UInt_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+#endif /* POISSONBOOTSTRAP_H_ */
@@ -0,0 +1,362 @@
+/*
+ * PurityFitter.h
+ *
+ * class to measure the photon purity of many bins, e.g. of photon pT and centrality, by template fits of sigmaIetaIeta.
+ *
+ * The data histogram of a bin is fitted with a signal template (prompt photons, e.g. from MC) and a background template
+ * (e.g. from the sideband of the isolation) by a binned extended maximum likelihood fit : the expected content of bin i is
+ *  mu_i = nSignal * s_i + nBackground * b_i
+ * where s_i and b_i are the templates normalized to 1 within the fit range, and -log L = sum_i (mu_i - d_i * log(mu_i)).
+ * With two linear parameters the gradient and the Hessian of -log L are analytic, so the minimum is found by Newton steps,
+ * usually in a few iterations, and the covariance of the yields is the inverse of the Hessian at the minimum.
+ *
+ * The purity is the fraction of signal among the photons of the signal region, sigmaIetaIeta < "signalRegionCut"
+ * (see cond_purity in GammaJetAnalyzer.h) : purity = nSignal * S / (nSignal * S + nBackground * B),
+ * S and B being the fractions of the templates in the signal region. Its error is propagated from the covariance of the yields.
+ * The statistical uncertainty of the templates is not included.
+ *
+ * The contents of the histograms are copied by addBin(), so the bins are fitted by several threads without ROOT objects.
+ *
+ * usage :
+ *  PurityFitter fitter(gja->cut_sigmaIetaIeta_lt);
+ *  fitter.setFitRange(0, 0.025);
+ *  for (int b = 0; b < nBins; ++b)  fitter.addBin(hData[b], hSignal[b], hBackground[b], Form("pt%d", b));
+ *  fitter.fit();
+ *  fitter.print();
+ *  TH1D* hPurity = fitter.getPurityHistogram("hPurity", nBins, ptBins);
+ */
+
+#ifndef PURITYFITTER_H_
+#define PURITYFITTER_H_
+
+#include <TH1.h>
+#include <TH1D.h>
+#include <TString.h>
+#include <TMath.h>
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+
+#include "histoUtil.h"
+
+// result of the fit of a bin
+struct purityFitResult {
+    TString label;
+    double  purity;
+    double  purityError;
+    double  nSignal;
+    double  nSignalError;
+    double  nBackground;
+    double  nBackgroundError;
+    double  correlation;        // correlation of nSignal and nBackground
+    double  nll;                // -log L at the minimum, without the constant terms
+    int     nIterations;
+    bool    converged;
+};
+
+class PurityFitter {
+public:
+    PurityFitter(double signalRegionCut);
+    virtual ~PurityFitter();
+
+    void setFitRange(double xMin, double xMax);
+    int  addBin(TH1* data, TH1* signalTemplate, TH1* backgroundTemplate, const char* label = "");
+    void fit(int nThreads = 0);
+    void clear();
+
+    int  getNBins() const;
+    const purityFitResult& getResult(int bin) const;
+    void print() const;
+    TH1D* getPurityHistogram(const char* name, int nBins = 0, const double binEdges[] = NULL) const;
+
+private:
+    // contents of a bin within the fit range, index is the histogram bin
+    struct fitInput {
+        std::vector<double> data;
+        std::vector<double> signal;         // normalized to 1
+        std::vector<double> background;     // normalized to 1
+        double signalInSignalRegion;        // fraction of the templates in the signal region
+        double backgroundInSignalRegion;
+    };
+
+    void   fitBin(int bin);
+    static double getNLL(const fitInput& input, double nSignal, double nBackground);
+
+    static const int maxIterations = 100;
+
+    double signalRegionCut;
+    double fitMin;
+    double fitMax;
+    std::vector<fitInput> inputs;
+    std::vector<purityFitResult> results;
+};
+
+/*
+ * "signalRegionCut" is the sigmaIetaIeta cut of the purity selection. The fit range is the range of the histograms by default.
+ */
+PurityFitter::PurityFitter(double signalRegionCut)
+{
+    this->signalRegionCut = signalRegionCut;
+    fitMin = 0;
+    fitMax = -1;
+}
+
+PurityFitter::~PurityFitter()
+{
+}
+
+/*
+ * fit the histogram bins whose centers are in [xMin, xMax], used by the following calls of addBin().
+ * xMax < xMin uses the whole range of the histograms.
+ */
+void PurityFitter::setFitRange(double xMin, double xMax)
+{
+    fitMin = xMin;
+    fitMax = xMax;
+}
+
+/*
+ * add a bin to be fitted : "data" is fitted with "signalTemplate" and "backgroundTemplate", the three histograms must have
+ * the same binning. Negative contents of the templates are set to 0. returns the index of the bin, -1 if it is not added.
+ */
+int PurityFitter::addBin(TH1* data, TH1* signalTemplate, TH1* backgroundTemplate, const char* label)
+{
+    if (!compareBinning(data, signalTemplate) || !compareBinning(data, backgroundTemplate)) {
+        std::cout << "PurityFitter : " << data->GetName() << " and its templates have different binnings, bin is not added." << std::endl;
+        return -1;
+    }
+
+    fitInput input;
+    input.signalInSignalRegion = 0;
+    input.backgroundInSignalRegion = 0;
+    double sumSignal = 0;
+    double sumBackground = 0;
+    for (int i = 1; i <= data->GetNbinsX(); ++i)
+    {
+        double x = data->GetBinCenter(i);
+        if (fitMax >= fitMin && (x < fitMin || x > fitMax))  continue;
+
+        double s = TMath::Max(signalTemplate->GetBinContent(i), 0.);
+        double b = TMath::Max(backgroundTemplate->GetBinContent(i), 0.);
+        // bins that neither template can populate do not constrain the yields
+        if (s == 0 && b == 0)  continue;
+
+        input.data.push_back(TMath::Max(data->GetBinContent(i), 0.));
+        input.signal.push_back(s);
+        input.background.push_back(b);
+        sumSignal += s;
+        sumBackground += b;
+        if (x < signalRegionCut) {
+            input.signalInSignalRegion += s;
+            input.backgroundInSignalRegion += b;
+        }
+    }
+    if (sumSignal <= 0 || sumBackground <= 0) {
+        std::cout << "PurityFitter : a template of " << data->GetName() << " is empty in the fit range, bin is not added." << std::endl;
+        return -1;
+    }
+
+    for (unsigned i = 0; i < input.data.size(); ++i) {
+        input.signal[i] /= sumSignal;
+        input.background[i] /= sumBackground;
+    }
+    input.signalInSignalRegion /= sumSignal;
+    input.backgroundInSignalRegion /= sumBackground;
+    inputs.push_back(input);
+
+    purityFitResult result = purityFitResult();
+    result.label = label;
+    results.push_back(result);
+    return inputs.size() - 1;
+}
+
+/*
+ * fit every bin, the bins are shared by "nThreads" threads. nThreads <= 0 uses one thread per core.
+ */
+void PurityFitter::fit(int nThreads)
+{
+    const int nBins = getNBins();
+    if (nThreads <= 0)  nThreads = std::thread::hardware_concurrency();
+    nThreads = TMath::Max(TMath::Min(nThreads, nBins), 1);
+
+    // the fit time differs between bins, a thread takes the next bin when it is done
+    std::atomic<int> next(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t) {
+        threads.push_back(std::thread([this, &next, nBins] {
+            int bin;
+            while ((bin = next++) < nBins)  fitBin(bin);
+        }));
+    }
+    for (int t = 0; t < nThreads; ++t)  threads[t].join();
+}
+
+void PurityFitter::clear()
+{
+    inputs.clear();
+    results.clear();
+}
+
+int PurityFitter::getNBins() const
+{
+    return inputs.size();
+}
+
+const purityFitResult& PurityFitter::getResult(int bin) const
+{
+    return results[bin];
+}
+
+/*
+ * print the results as a table, one line per bin
+ */
+void PurityFitter::print() const
+{
+    std::cout << std::setw(20) << "bin" << std::setw(24) << "purity" << std::setw(26) << "nSignal"
+              << std::setw(26) << "nBackground" << std::setw(12) << "iterations" << std::endl;
+    for (int b = 0; b < getNBins(); ++b)
+    {
+        const purityFitResult& r = results[b];
+        std::cout << std::setw(20) << r.label.Data()
+                  << std::fixed << std::setprecision(4)
+                  << std::setw(12) << r.purity << " +- " << std::setw(8) << r.purityError
+                  << std::setprecision(1)
+                  << std::setw(13) << r.nSignal << " +- " << std::setw(9) << r.nSignalError
+                  << std::setw(13) << r.nBackground << " +- " << std::setw(9) << r.nBackgroundError
+                  << std::setw(12) << r.nIterations << (r.converged ? "" : "  not converged") << std::endl;
+        std::cout.unsetf(std::ios_base::floatfield);
+    }
+    std::cout << std::setprecision(6);
+}
+
+/*
+ * histogram of the purity with its error, bin b+1 is the fitted bin b.
+ * The bins have the edges "binEdges" (nBins+1 values), e.g. photon pT bins, or are labeled by the labels of addBin() if nBins = 0.
+ */
+TH1D* PurityFitter::getPurityHistogram(const char* name, int nBins, const double binEdges[]) const
+{
+    TH1D* hist;
+    if (nBins > 0 && binEdges != NULL) {
+        if (nBins != getNBins()) {
+            std::cout << "PurityFitter : " << name << " has " << nBins << " bins, there are " << getNBins() << " fitted bins." << std::endl;
+        }
+        hist = new TH1D(name, ";;purity", nBins, binEdges);
+    }
+    else {
+        hist = new TH1D(name, ";;purity", TMath::Max(getNBins(), 1), 0, TMath::Max(getNBins(), 1));
+        for (int b = 0; b < getNBins(); ++b)  hist->GetXaxis()->SetBinLabel(b + 1, results[b].label.Data());
+    }
+
+    for (int b = 0; b < getNBins() && b < hist->GetNbinsX(); ++b) {
+        hist->SetBinContent(b + 1, results[b].purity);
+        hist->SetBinError(b + 1, results[b].purityError);
+    }
+    return hist;
+}
+
+/*
+ * fit bin "bin" by Newton steps on (nSignal, nBackground), run by a worker thread.
+ * A step is halved until -log L decreases and the yields stay positive.
+ */
+void PurityFitter::fitBin(int bin)
+{
+    const fitInput& input = inputs[bin];
+    purityFitResult& result = results[bin];
+    const int n = input.data.size();
+
+    double total = 0;
+    for (int i = 0; i < n; ++i)  total += input.data[i];
+    if (total <= 0) {
+        result.converged = false;
+        return;
+    }
+
+    double nSignal = 0.5 * total;
+    double nBackground = 0.5 * total;
+    double nll = getNLL(input, nSignal, nBackground);
+    double hSS = 0, hSB = 0, hBB = 0;
+    bool converged = false;
+    int iteration = 0;
+    for (iteration = 1; iteration <= maxIterations && !converged; ++iteration)
+    {
+        // gradient and Hessian of -log L
+        double gS = 0, gB = 0;
+        hSS = 0; hSB = 0; hBB = 0;
+        for (int i = 0; i < n; ++i) {
+            double mu = nSignal * input.signal[i] + nBackground * input.background[i];
+            double r = input.data[i] / mu;
+            double r2 = r / mu;
+            gS += input.signal[i] * (1 - r);
+            gB += input.background[i] * (1 - r);
+            hSS += input.signal[i] * input.signal[i] * r2;
+            hSB += input.signal[i] * input.background[i] * r2;
+            hBB += input.background[i] * input.background[i] * r2;
+        }
+        double det = hSS * hBB - hSB * hSB;
+        if (det <= 0)  break;
+
+        double stepS = -( hBB * gS - hSB * gB) / det;
+        double stepB = -(-hSB * gS + hSS * gB) / det;
+
+        // the yields stay above a tiny fraction of the total, where mu > 0 for every bin with data
+        const double minYield = 1e-12 * total;
+        double t = 1;
+        double nextS, nextB, nextNLL;
+        int nHalvings = 0;
+        do {
+            nextS = TMath::Max(nSignal + t * stepS, minYield);
+            nextB = TMath::Max(nBackground + t * stepB, minYield);
+            nextNLL = getNLL(input, nextS, nextB);
+            t *= 0.5;
+        } while (nextNLL > nll && ++nHalvings < 50);
+        if (nextNLL > nll)  break;
+
+        converged = (nll - nextNLL < 1e-10 * (1 + TMath::Abs(nll))) &&
+                    (TMath::Abs(nextS - nSignal) + TMath::Abs(nextB - nBackground) < 1e-8 * total);
+        nSignal = nextS;
+        nBackground = nextB;
+        nll = nextNLL;
+    }
+
+    // covariance of the yields is the inverse of the Hessian
+    double det = hSS * hBB - hSB * hSB;
+    double varS = (det > 0) ? hBB / det : 0;
+    double varB = (det > 0) ? hSS / det : 0;
+    double covSB = (det > 0) ? -hSB / det : 0;
+
+    const double S = input.signalInSignalRegion;
+    const double B = input.backgroundInSignalRegion;
+    const double inSignalRegion = nSignal * S + nBackground * B;
+    double purity = (inSignalRegion > 0) ? nSignal * S / inSignalRegion : 0;
+    double dS = (inSignalRegion > 0) ?  S * nBackground * B / (inSignalRegion * inSignalRegion) : 0;
+    double dB = (inSignalRegion > 0) ? -S * nSignal * B / (inSignalRegion * inSignalRegion) : 0;
+
+    result.purity = purity;
+    result.purityError = TMath::Sqrt(TMath::Max(dS * dS * varS + 2 * dS * dB * covSB + dB * dB * varB, 0.));
+    result.nSignal = nSignal;
+    result.nSignalError = TMath::Sqrt(varS);
+    result.nBackground = nBackground;
+    result.nBackgroundError = TMath::Sqrt(varB);
+    result.correlation = (varS > 0 && varB > 0) ? covSB / TMath::Sqrt(varS * varB) : 0;
+    result.nll = nll;
+    result.nIterations = iteration - 1;
+    result.converged = converged;
+}
+
+/*
+ * -log L without the terms that do not depend on the yields
+ */
+double PurityFitter::getNLL(const fitInput& input, double nSignal, double nBackground)
+{
+    double nll = nSignal + nBackground;     // sum of mu_i, the templates are normalized
+    for (unsigned i = 0; i < input.data.size(); ++i) {
+        if (input.data[i] <= 0)  continue;
+        nll -= input.data[i] * TMath::Log(nSignal * input.signal[i] + nBackground * input.background[i]);
+    }
+    return nll;
+}
+
+#endif /* PURITYFITTER_H_ */
@@ -0,0 +1,144 @@
+/*
+ * benchmarkUtil.h
+ *
+ * utilities to measure the throughput of a code path and to write the results in a machine-readable format.
+ * Each result is written as a single line of JSON ("JSON Lines"), so that results from different versions can be
+ * appended to the same file and compared.
+ */
+
+#ifndef BENCHMARKUTIL_H_
+#define BENCHMARKUTIL_H_
+
+#include <TStopwatch.h>
+#include <TString.h>
+
+#include <sys/resource.h>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+
+struct benchmarkResult {
+    TString  name;          // name of the code path
+    TString  collision;     // collision type of the input
+    Long64_t events;        // number of events processed
+    double   realTime;      // wall-clock time in seconds
+    double   cpuTime;       // CPU time in seconds
+    long     peakRSS;       // peak resident set size in kB
+    Long64_t allocations;   // heap allocations, -1 if they are not counted (see HIUTILS_PERF_ALLOC in perfUtil.h)
+};
+
+void            resetPeakRSS();
+long            getPeakRSS();
+void            startBenchmark(TStopwatch* watch);
+benchmarkResult stopBenchmark (TStopwatch* watch, const char* name, const char* collision, Long64_t events);
+double          getEventsPerSecond(benchmarkResult result);
+void            printBenchmarkResult(benchmarkResult result);
+void            writeBenchmarkResult(const char* fileName, benchmarkResult result, const char* tag = "");
+
+/*
+ * reset the peak resident set size of the process to the current resident set size.
+ * This is supported by Linux only, on other systems getPeakRSS() returns the peak since the start of the process.
+ *
+ * https://www.kernel.org/doc/Documentation/filesystems/proc.txt
+ */
+void resetPeakRSS()
+{
+    FILE* f = fopen("/proc/self/clear_refs", "w");
+    if(f != NULL) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+/*
+ * peak resident set size in kB.
+ * "VmHWM" in /proc/self/status is used if it exists, as it can be reset by resetPeakRSS().
+ */
+long getPeakRSS()
+{
+    long peak = -1;
+    FILE* f = fopen("/proc/self/status", "r");
+    if(f != NULL) {
+        char line[256];
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                sscanf(line + 6, "%ld", &peak);
+                break;
+            }
+        }
+        fclose(f);
+    }
+
+    if(peak < 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        peak = usage.ru_maxrss;
+    }
+    return peak;
+}
+
+void startBenchmark(TStopwatch* watch)
+{
+    resetPeakRSS();
+    watch->Start(kTRUE);
+}
+
+benchmarkResult stopBenchmark(TStopwatch* watch, const char* name, const char* collision, Long64_t events)
+{
+    watch->Stop();
+
+    benchmarkResult result;
+    result.name = name;
+    result.collision = collision;
+    result.events = events;
+    result.realTime = watch->RealTime();
+    result.cpuTime  = watch->CpuTime();
+    result.peakRSS  = getPeakRSS();
+    result.allocations = -1;
+
+    return result;
+}
+
+double getEventsPerSecond(benchmarkResult result)
+{
+    if(result.realTime <= 0)  return 0;
+
+    return result.events / result.realTime;
+}
+
+void printBenchmarkResult(benchmarkResult result)
+{
+    std::cout << std::left  << std::setw(40) << result.name.Data()
+              << std::setw(6)  << result.collision.Data()
+              << std::right << std::setw(12) << std::fixed << std::setprecision(1) << getEventsPerSecond(result) << " events/s"
+              << std::setw(10) << std::setprecision(3) << result.realTime << " s wall"
+              << std::setw(10) << result.cpuTime << " s cpu"
+              << std::setw(10) << result.peakRSS << " kB peak RSS";
+    if(result.allocations >= 0) {
+        std::cout << std::setw(12) << result.allocations << " allocations";
+    }
+    std::cout << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+/*
+ * append "result" as a JSON line to file "fileName".
+ * "tag" identifies the version of the code, e.g. output of "git describe".
+ */
+void writeBenchmarkResult(const char* fileName, benchmarkResult result, const char* tag)
+{
+    std::ofstream out(fileName, std::ios_base::app);
+    out << Form("{\"tag\": \"%s\", \"benchmark\": \"%s\", \"collision\": \"%s\", \"events\": %lld, "
+                "\"real_time_s\": %.6f, \"cpu_time_s\": %.6f, \"events_per_s\": %.3f, \"peak_rss_kB\": %ld",
+                tag, result.name.Data(), result.collision.Data(), result.events,
+                result.realTime, result.cpuTime, getEventsPerSecond(result), result.peakRSS);
+    if(result.allocations >= 0) {
+        out << Form(", \"allocations\": %lld", result.allocations);
+    }
+    out << "}" << std::endl;
+}
+
+#endif /* BENCHMARKUTIL_H_ */
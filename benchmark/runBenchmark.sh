@@ -0,0 +1,12 @@
+#!/bin/sh
+
+progName="benchmark_GammaJetAnalyzer";
+nEvents=100000;
+outputFile="benchmark_GammaJetAnalyzer.jsonl";
+# version of the code, results of different versions are appended to the same output file
+tag=$(git describe --always --dirty 2>/dev/null || echo "unknown");
+
+# add "-DHIUTILS_PERF -DHIUTILS_PERF_ALLOC" to record the heap allocations of the event loop as well
+g++ $progName.C $(root-config --cflags --libs) -Wall -O2 -o $progName.exe
+
+./$progName.exe $outputFile $nEvents $tag
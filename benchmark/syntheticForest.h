@@ -0,0 +1,250 @@
+/*
+ * syntheticForest.h
+ *
+ * utilities to generate synthetic HiForest files for benchmarks.
+ * The generated files have the same tree layout as the HiForest files read by GammaJetAnalyzer :
+ *
+ *  hiEvtAnalyzer/HiTree
+ *  skimanalysis/HltTree
+ *  multiPhotonAnalyzer/photon
+ *  ak3PFJetAnalyzer/t
+ *  akPu3PFJetAnalyzer/t
+ *
+ * The values of the branches are random, but their distributions are chosen such that
+ * every selection of GammaJetAnalyzer is passed by some of the objects and failed by others.
+ */
+
+#ifndef SYNTHETICFOREST_H_
+#define SYNTHETICFOREST_H_
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TDirectory.h>
+#include <TRandom3.h>
+#include <TMath.h>
+
+#include <iostream>
+
+enum syntheticCollisionType {
+    synthetic_pp,
+    synthetic_pPb,
+    synthetic_PbPb
+};
+
+const int SYNTHETIC_MAXPHOTONS = 500;
+const int SYNTHETIC_MAXJETS = 500;
+
+struct syntheticForestConfig {
+    syntheticCollisionType collision;
+    Long64_t nEvents;
+    float meanPhotons;      // mean of the Poisson distribution for the number of photons in an event
+    float meanJets;         // mean of the Poisson distribution for the number of jets in an event
+    UInt_t seed;            // seed of the random number generator, same seed gives the same file
+};
+
+syntheticForestConfig getSyntheticForestConfig(syntheticCollisionType collision, Long64_t nEvents = 10000);
+const char*           getSyntheticCollisionName(syntheticCollisionType collision);
+void                  makeSyntheticForest(const char* fileName, syntheticForestConfig config);
+
+/*
+ * default configuration for a given collision type.
+ * multiplicities increase from pp to PbPb, the values can be modified before calling makeSyntheticForest().
+ */
+syntheticForestConfig getSyntheticForestConfig(syntheticCollisionType collision, Long64_t nEvents)
+{
+    syntheticForestConfig config;
+    config.collision = collision;
+    config.nEvents = nEvents;
+    config.seed = 12345;
+
+    if(collision == synthetic_pp) {
+        config.meanPhotons = 2;
+        config.meanJets = 6;
+    }
+    else if(collision == synthetic_pPb) {
+        config.meanPhotons = 4;
+        config.meanJets = 12;
+    }
+    else {
+        config.meanPhotons = 12;
+        config.meanJets = 40;
+    }
+
+    return config;
+}
+
+const char* getSyntheticCollisionName(syntheticCollisionType collision)
+{
+    if(collision == synthetic_pp)         return "pp";
+    else if(collision == synthetic_pPb)   return "pPb";
+    else                                  return "PbPb";
+}
+
+/*
+ * write a synthetic HiForest file with "config.nEvents" events.
+ * The number of objects in an event is drawn from a Poisson distribution and truncated at
+ * SYNTHETIC_MAXPHOTONS / SYNTHETIC_MAXJETS.
+ */
+void makeSyntheticForest(const char* fileName, syntheticForestConfig config)
+{
+    TRandom3 rand(config.seed);
+    TFile* file = new TFile(fileName, "RECREATE");
+
+    ////////// hiEvtAnalyzer/HiTree //////////
+    Int_t run, evt, lumi;
+    Float_t vz;
+    Int_t hiBin;
+    Float_t hiHFplusEta4, hiHFminusEta4;
+
+    file->mkdir("hiEvtAnalyzer")->cd();
+    TTree* evtTree = new TTree("HiTree", "synthetic HiTree");
+    evtTree->Branch("run",  &run,  "run/I");
+    evtTree->Branch("evt",  &evt,  "evt/I");
+    evtTree->Branch("lumi", &lumi, "lumi/I");
+    evtTree->Branch("vz",   &vz,   "vz/F");
+    evtTree->Branch("hiBin", &hiBin, "hiBin/I");
+    evtTree->Branch("hiHFplusEta4",  &hiHFplusEta4,  "hiHFplusEta4/F");
+    evtTree->Branch("hiHFminusEta4", &hiHFminusEta4, "hiHFminusEta4/F");
+
+    ////////// skimanalysis/HltTree //////////
+    Int_t pcollisionEventSelection, pHBHENoiseFilter, pPAcollisionEventSelectionPA;
+
+    file->mkdir("skimanalysis")->cd();
+    TTree* skimTree = new TTree("HltTree", "synthetic HltTree");
+    skimTree->Branch("pcollisionEventSelection", &pcollisionEventSelection, "pcollisionEventSelection/I");
+    skimTree->Branch("pHBHENoiseFilter", &pHBHENoiseFilter, "pHBHENoiseFilter/I");
+    skimTree->Branch("pPAcollisionEventSelectionPA", &pPAcollisionEventSelectionPA, "pPAcollisionEventSelectionPA/I");
+
+    ////////// multiPhotonAnalyzer/photon //////////
+    Int_t nPhotons;
+    Float_t pt[SYNTHETIC_MAXPHOTONS];
+    Float_t eta[SYNTHETIC_MAXPHOTONS];
+    Float_t phi[SYNTHETIC_MAXPHOTONS];
+    Float_t cc4[SYNTHETIC_MAXPHOTONS];
+    Float_t cr4[SYNTHETIC_MAXPHOTONS];
+    Float_t ct4PtCut20[SYNTHETIC_MAXPHOTONS];
+    Float_t trkSumPtHollowConeDR04[SYNTHETIC_MAXPHOTONS];
+    Float_t hcalTowerSumEtConeDR04[SYNTHETIC_MAXPHOTONS];
+    Float_t ecalRecHitSumEtConeDR04[SYNTHETIC_MAXPHOTONS];
+    Float_t hadronicOverEm[SYNTHETIC_MAXPHOTONS];
+    Float_t sigmaIetaIeta[SYNTHETIC_MAXPHOTONS];
+    Int_t isEle[SYNTHETIC_MAXPHOTONS];
+    Float_t sigmaIphiIphi[SYNTHETIC_MAXPHOTONS];
+    Float_t swissCrx[SYNTHETIC_MAXPHOTONS];
+    Float_t seedTime[SYNTHETIC_MAXPHOTONS];
+
+    file->mkdir("multiPhotonAnalyzer")->cd();
+    TTree* photonTree = new TTree("photon", "synthetic photon tree");
+    photonTree->Branch("nPhotons", &nPhotons, "nPhotons/I");
+    photonTree->Branch("pt",  pt,  "pt[nPhotons]/F");
+    photonTree->Branch("eta", eta, "eta[nPhotons]/F");
+    photonTree->Branch("phi", phi, "phi[nPhotons]/F");
+    photonTree->Branch("cc4", cc4, "cc4[nPhotons]/F");
+    photonTree->Branch("cr4", cr4, "cr4[nPhotons]/F");
+    photonTree->Branch("ct4PtCut20", ct4PtCut20, "ct4PtCut20[nPhotons]/F");
+    photonTree->Branch("trkSumPtHollowConeDR04",  trkSumPtHollowConeDR04,  "trkSumPtHollowConeDR04[nPhotons]/F");
+    photonTree->Branch("hcalTowerSumEtConeDR04",  hcalTowerSumEtConeDR04,  "hcalTowerSumEtConeDR04[nPhotons]/F");
+    photonTree->Branch("ecalRecHitSumEtConeDR04", ecalRecHitSumEtConeDR04, "ecalRecHitSumEtConeDR04[nPhotons]/F");
+    photonTree->Branch("hadronicOverEm", hadronicOverEm, "hadronicOverEm[nPhotons]/F");
+    photonTree->Branch("sigmaIetaIeta",  sigmaIetaIeta,  "sigmaIetaIeta[nPhotons]/F");
+    photonTree->Branch("isEle", isEle, "isEle[nPhotons]/I");
+    photonTree->Branch("sigmaIphiIphi", sigmaIphiIphi, "sigmaIphiIphi[nPhotons]/F");
+    photonTree->Branch("swissCrx", swissCrx, "swissCrx[nPhotons]/F");
+    photonTree->Branch("seedTime", seedTime, "seedTime[nPhotons]/F");
+
+    ////////// ak3PFJetAnalyzer/t and akPu3PFJetAnalyzer/t //////////
+    // both jet collections have the same layout, akPu3PF jets are the ak3PF jets after pile-up subtraction.
+    Int_t nref;
+    Float_t jtpt[SYNTHETIC_MAXJETS];
+    Float_t jteta[SYNTHETIC_MAXJETS];
+    Float_t jtphi[SYNTHETIC_MAXJETS];
+    Float_t jtptPu[SYNTHETIC_MAXJETS];
+
+    file->mkdir("ak3PFJetAnalyzer")->cd();
+    TTree* ak3PFJetTree = new TTree("t", "synthetic ak3PF jet tree");
+    ak3PFJetTree->Branch("nref",  &nref, "nref/I");
+    ak3PFJetTree->Branch("jtpt",  jtpt,  "jtpt[nref]/F");
+    ak3PFJetTree->Branch("jteta", jteta, "jteta[nref]/F");
+    ak3PFJetTree->Branch("jtphi", jtphi, "jtphi[nref]/F");
+
+    file->mkdir("akPu3PFJetAnalyzer")->cd();
+    TTree* akPu3PFJetTree = new TTree("t", "synthetic akPu3PF jet tree");
+    akPu3PFJetTree->Branch("nref",  &nref,  "nref/I");
+    akPu3PFJetTree->Branch("jtpt",  jtptPu, "jtpt[nref]/F");
+    akPu3PFJetTree->Branch("jteta", jteta,  "jteta[nref]/F");
+    akPu3PFJetTree->Branch("jtphi", jtphi,  "jtphi[nref]/F");
+
+    const double pi = TMath::Pi();
+    for(Long64_t i = 0; i < config.nEvents; ++i)
+    {
+        if (i % 100000 == 0)  {
+            std::cout << "synthetic forest : current entry = " << i << " out of " << config.nEvents << std::endl;
+        }
+
+        run  = 1;
+        lumi = 1 + (Int_t)(i / 1000);
+        evt  = (Int_t)i + 1;
+        vz   = rand.Gaus(0, 6);
+
+        if(config.collision == synthetic_PbPb) {
+            hiBin = (Int_t)rand.Uniform(0, 200);
+            // HF energy decreases with centrality bin
+            hiHFplusEta4  = rand.Gaus(2000 * (1 - hiBin / 200.), 50);
+            hiHFminusEta4 = rand.Gaus(2000 * (1 - hiBin / 200.), 50);
+        }
+        else if(config.collision == synthetic_pPb) {
+            hiBin = 0;
+            hiHFplusEta4  = rand.Exp(15);
+            hiHFminusEta4 = rand.Exp(15);
+        }
+        else {
+            hiBin = 0;
+            hiHFplusEta4  = rand.Exp(2);
+            hiHFminusEta4 = rand.Exp(2);
+        }
+
+        pcollisionEventSelection     = (rand.Uniform() < 0.95);
+        pHBHENoiseFilter             = (rand.Uniform() < 0.98);
+        pPAcollisionEventSelectionPA = (rand.Uniform() < 0.95);
+
+        nPhotons = TMath::Min(rand.Poisson(config.meanPhotons), SYNTHETIC_MAXPHOTONS);
+        for(int j = 0; j < nPhotons; ++j)
+        {
+            pt[j]  = 10 + rand.Exp(20);
+            eta[j] = rand.Uniform(-2.5, 2.5);
+            phi[j] = rand.Uniform(-pi, pi);
+            cc4[j] = rand.Gaus(0, 3);
+            cr4[j] = rand.Gaus(0, 3);
+            ct4PtCut20[j] = rand.Exp(2);
+            trkSumPtHollowConeDR04[j]  = rand.Exp(2.5);
+            hcalTowerSumEtConeDR04[j]  = rand.Exp(2);
+            ecalRecHitSumEtConeDR04[j] = rand.Exp(3);
+            hadronicOverEm[j] = rand.Exp(0.05);
+            sigmaIetaIeta[j]  = TMath::Abs(rand.Gaus(0.010, 0.004));
+            isEle[j] = (rand.Uniform() < 0.1);
+            sigmaIphiIphi[j]  = TMath::Abs(rand.Gaus(0.011, 0.005));
+            swissCrx[j] = rand.Uniform(0, 1);
+            seedTime[j] = rand.Gaus(0, 2);
+        }
+
+        nref = TMath::Min(rand.Poisson(config.meanJets), SYNTHETIC_MAXJETS);
+        for(int j = 0; j < nref; ++j)
+        {
+            jtpt[j]   = 5 + rand.Exp(20);
+            jtptPu[j] = TMath::Max(jtpt[j] - rand.Exp(5), 1.);
+            jteta[j]  = rand.Uniform(-4, 4);
+            jtphi[j]  = rand.Uniform(-pi, pi);
+        }
+
+        evtTree->Fill();
+        skimTree->Fill();
+        photonTree->Fill();
+        ak3PFJetTree->Fill();
+        akPu3PFJetTree->Fill();
+    }
+
+    file->Write();
+    file->Close();
+}
+
+#endif /* SYNTHETICFOREST_H_ */
@@ -9,20 +9,30 @@
 #include <TCut.h>
 #include <TList.h>
 #include <TKey.h>
+#include <TClass.h>
 #include <TDirectoryFile.h>
 #include <TH1.h>
 #include <TFile.h>
 #include <TCanvas.h>
 #include <TSystem.h>
 #include <TGraph.h>
+#include <TMath.h>
+
+#include <TROOT.h>
 
 #include <iostream>
 #include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
 
 void     mergeCuts(TCut cut, TCut* cuts, int len);
 void     mergeCuts(TCut cut, TCut* cuts);
 int      getNumBins(double xmin, double xmax, int numBinsPerUnitX);
 bool     compareHistograms(TH1* h1, TH1* h2);
+bool     compareBinning(TH1* h1, TH1* h2);
 TList*   divideHistogramList(TList* histoList1   , TList* histoList2,    int rebinFactor=1, bool DoScale=true);
 TList*   divideHistogramList(TDirectoryFile* dir1, TDirectoryFile* dir2, int rebinFactor=1, bool DoScale=true);
 TList*   getListOfSOMEKeys(TDirectoryFile* dir, const char* pattern);
@@ -33,12 +43,31 @@ TList*   getListOfALLKeys (TDirectoryFile* dir, const char* type, bool inheritsF
 TList*   getListOfHistograms   (TDirectoryFile* dir, const char* pattern="");
 TList*   getListOfALLHistograms(TDirectoryFile* dir);
 void     saveAllHistogramsToFile(const char* fileName, TList* histos);
+int      mergeHistogramFiles(const char* outputFileName, int nFiles, const char* inputFileNames[], int nThreads = 0);
+TDirectory* makeDirectory(TDirectory* dir, const char* path);
+std::string getDirectoryPath(TDirectory* dir);
 void     saveAllHistogramsToPicture(TDirectoryFile* dir, const char* fileType="gif", const char* directoryToBeSavedIn="", int styleIndex=0, int rebin=1);
 void     saveAllHistogramsToPicture(TDirectoryFile* dir, const char* fileType="gif", int dirType=0                      , int styleIndex=0, int rebin=1);
 void     saveAllGraphsToPicture(TDirectoryFile* dir, const char* fileType="gif", const char* directoryToBeSavedIn="", int styleIndex=0);
 void     saveAllGraphsToPicture(TDirectoryFile* dir, const char* fileType="gif", int dirType=0                      , int styleIndex=0);
 void     saveAllCanvasesToPicture(TList* canvases      , const char* fileType="gif", const char* directoryToBeSavedIn="");
 
+// histograms of a set of files paired by their path in the files, see mergeHistogramFiles()
+struct mergedHistograms {
+    std::string                source;     // files whose histograms are in this set
+    std::vector<std::string>   paths;      // in the order they are found, e.g. "dir/fPt_purity"
+    std::map<std::string, int> index;      // index of each path in "paths"
+    std::vector<TH1*>          histos;     // sum of the histograms with the same path
+    std::vector<int>           nFiles;     // number of files in the sum
+    std::set<std::string>      skipped;    // paths of the objects that are not histograms
+    std::vector<std::string>   messages;   // mismatches
+};
+
+std::string getKeyPath(TKey* key);
+void     addToMergedHistograms(mergedHistograms* merged, const std::string& path, TH1* h, int nFiles, const std::string& source);
+void     readHistogramFiles(int first, int last, const char* fileNames[], mergedHistograms* merged);
+void     mergeHistogramSets(mergedHistograms* merged, mergedHistograms* other);
+
 using  std::cout;
 using  std::endl;
 
@@ -106,6 +135,33 @@ bool compareHistograms(TH1* h1, TH1* h2)
 	return true;
 }
 
+/*
+ * true if the two histograms have the same dimension and the same bin edges on every axis, i.e. they can be added
+ */
+bool compareBinning(TH1* h1, TH1* h2)
+{
+    if (h1->GetDimension() != h2->GetDimension())
+        return false;
+
+    TAxis* axes1[3] = {h1->GetXaxis(), h1->GetYaxis(), h1->GetZaxis()};
+    TAxis* axes2[3] = {h2->GetXaxis(), h2->GetYaxis(), h2->GetZaxis()};
+    for (int d = 0; d < h1->GetDimension(); ++d)
+    {
+        int numBins = axes1[d]->GetNbins();
+        if (numBins != axes2[d]->GetNbins())
+            return false;
+
+        for (int i = 1; i <= numBins; ++i)
+        {
+            if (axes1[d]->GetBinLowEdge(i) != axes2[d]->GetBinLowEdge(i))
+                return false;
+        }
+        if (axes1[d]->GetBinUpEdge(numBins) != axes2[d]->GetBinUpEdge(numBins))
+            return false;
+    }
+    return true;
+}
+
 /*
  *  divide histograms element wise
  *
@@ -173,7 +229,7 @@ TList* divideHistogramList(TDirectoryFile* dir1, TDirectoryFile* dir2, int rebin
 TList* getListOfSOMEKeys(TDirectoryFile* dir, const char* pattern)
 {
     TList* keysInDir = dir->GetListOfKeys();
-    TIter* iter = new TIter(keysInDir);
+    TIter iter(keysInDir);
 
     TDirectoryFile *subdir;
     TKey*  key;
@@ -181,7 +237,7 @@ TList* getListOfSOMEKeys(TDirectoryFile* dir, const char* pattern)
     TList* newKeys=new TList();
     TString keyName;
 
-    while ((key=(TKey*)iter->Next())) {
+    while ((key=(TKey*)iter.Next())) {
 
         keyName=key->GetName();
         if(keyName.Contains(pattern))
@@ -209,7 +265,7 @@ TList* getListOfSOMEKeys(TDirectoryFile* dir, const char* pattern)
 TList* getListOfSOMEKeys(TDirectoryFile* dir, const char* pattern, const char* type /* ="" */ )
 {
     TList* keysInDir = dir->GetListOfKeys();
-    TIter* iter = new TIter(keysInDir);
+    TIter iter(keysInDir);
 
     TDirectoryFile *subdir;
     TKey*  key;
@@ -217,7 +273,7 @@ TList* getListOfSOMEKeys(TDirectoryFile* dir, const char* pattern, const char* t
     TList* newKeys=new TList();
     TString keyName;
 
-    while ((key=(TKey*)iter->Next())) {
+    while ((key=(TKey*)iter.Next())) {
 
         keyName=key->GetName();
         if(keyName.Contains(pattern) && strcmp(key->GetClassName(), type) == 0)
@@ -239,19 +295,20 @@ TList* getListOfSOMEKeys(TDirectoryFile* dir, const char* pattern, const char* t
 TList* getListOfALLKeys(TDirectoryFile* dir)
 {
     TList* keysInDir = dir->GetListOfKeys();
-    TIter* iter = new TIter(keysInDir);
+    TIter iter(keysInDir);
 
     TDirectoryFile *subdir;
     TKey*  key;
     TList* keys=new TList();
     TList *newKeys=new TList();
 
-    while ((key=(TKey*)iter->Next())) {
+    while ((key=(TKey*)iter.Next())) {
 
         keys->Add(key);
 
         // traverse directories in a DFS manner (recursively)
-        if(key->IsFolder())
+        // trees are folders as well, but not directories
+        if(key->IsFolder() && strcmp(key->GetClassName(), "TDirectoryFile") == 0)
         {
             subdir=(TDirectoryFile*)key->ReadObj();
             newKeys=getListOfALLKeys(subdir);
@@ -268,14 +325,14 @@ TList* getListOfALLKeys(TDirectoryFile* dir, const char* type)
 {
 
     TList* keysInDir = dir->GetListOfKeys();
-    TIter* iter = new TIter(keysInDir);
+    TIter iter(keysInDir);
 
     TDirectoryFile *subdir;
     TKey*  key;
     TList* keysOfType=new TList();
     TList *newKeys=new TList();
 
-    while ((key=(TKey*)iter->Next())) {
+    while ((key=(TKey*)iter.Next())) {
 
         //      http://www.cplusplus.com/reference/cstring/strcmp/
         if(strcmp(key->GetClassName(), type) == 0)
@@ -307,14 +364,14 @@ TList* getListOfALLKeys(TDirectoryFile* dir, const char* type, bool inheritsFrom
         return getListOfALLKeys(dir, type);
 
     TList* keysInDir = dir->GetListOfKeys();
-    TIter* iter = new TIter(keysInDir);
+    TIter iter(keysInDir);
 
     TDirectoryFile *subdir;
     TKey*  key;
     TList* keysOfType=new TList();
     TList *newKeys=new TList();
 
-    while ((key=(TKey*)iter->Next())) {
+    while ((key=(TKey*)iter.Next())) {
 
         if(key->ReadObj()->InheritsFrom(type))
         {
@@ -342,9 +399,9 @@ TList* getListOfHistograms(TDirectoryFile* dir, const char* pattern /* ="" */ )
     TList* histos=new TList();
     TList* keysHisto = getListOfSOMEKeys(dir, pattern, "TH1D");
 
-    TIter* iter = new TIter(keysHisto);
+    TIter iter(keysHisto);
     TKey*  key;
-    while ((key=(TKey*)iter->Next()))
+    while ((key=(TKey*)iter.Next()))
     {
         histos->Add((TH1D*)key->ReadObj());
     }
@@ -360,9 +417,9 @@ TList* getListOfALLHistograms(TDirectoryFile* dir)
     TList* histos=new TList();
     TList* keysHisto = getListOfALLKeys(dir, "TH1D");
 
-    TIter* iter = new TIter(keysHisto);
+    TIter iter(keysHisto);
     TKey*  key;
-    while ((key=(TKey*)iter->Next()))
+    while ((key=(TKey*)iter.Next()))
     {
         histos->Add((TH1D*)key->ReadObj());
     }
@@ -371,13 +428,17 @@ TList* getListOfALLHistograms(TDirectoryFile* dir)
 }
 
 
+/*
+ * write the histograms into the top directory of a new file "fileName".
+ * see OutputWriter.h to keep the directories of the histograms, set the compression and write on a background thread.
+ */
 void saveAllHistogramsToFile(const char* fileName, TList* histos)
 {
     TFile* f=new TFile(fileName, "RECREATE");
 
     TH1D* h;
-    TIter* iter = new TIter(histos);
-    while ((h=(TH1D*)iter->Next()))
+    TIter iter(histos);
+    while ((h=(TH1D*)iter.Next()))
     {
         h->Write();
     }
@@ -385,6 +446,225 @@ void saveAllHistogramsToFile(const char* fileName, TList* histos)
     f->Close();
 }
 
+/*
+ * merge the histograms of the files "inputFileNames" into "outputFileName", same as hadd for histograms.
+ * Histograms are paired by their path in the files, the directory structure is kept in the output file.
+ *
+ * The files are split into "nThreads" groups, each group is read and summed by a worker thread,
+ * then the sums of the groups are added pairwise in parallel (tree reduction). nThreads = 0 uses one thread per core.
+ * Histograms are added in the same order for a given nThreads, so the result is reproducible.
+ *
+ * Mismatches are reported, not skipped silently : a histogram with a different binning than the one of the first file
+ * is not added, a histogram that is not in every file is merged from the files that have it.
+ * Objects that are not histograms, e.g. trees, are not written to the output.
+ * Returns the number of reported mismatches.
+ */
+int mergeHistogramFiles(const char* outputFileName, int nFiles, const char* inputFileNames[], int nThreads /* =0 */)
+{
+    if (nFiles <= 0)
+    {
+        cout << "mergeHistogramFiles : no input file is given, " << outputFileName << " is not written." << endl;
+        return 0;
+    }
+    if (nThreads <= 0)
+        nThreads = std::thread::hardware_concurrency();
+    nThreads = TMath::Max(TMath::Min(nThreads, nFiles), 1);
+
+    // every thread opens its own files
+    ROOT::EnableThreadSafety();
+    bool addDirectory = TH1::AddDirectoryStatus();
+    TH1::AddDirectory(false);
+
+    std::vector<mergedHistograms> sets(nThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t)
+    {
+        int first = (int)((Long64_t)nFiles * t / nThreads);
+        int last  = (int)((Long64_t)nFiles * (t+1) / nThreads);
+        threads.push_back(std::thread(readHistogramFiles, first, last, inputFileNames, &sets[t]));
+    }
+    for (int t = 0; t < nThreads; ++t)
+        threads[t].join();
+
+    // tree reduction : sets[w] += sets[w + step]
+    for (int step = 1; step < nThreads; step *= 2)
+    {
+        threads.clear();
+        for (int w = 0; w + step < nThreads; w += 2*step)
+            threads.push_back(std::thread(mergeHistogramSets, &sets[w], &sets[w + step]));
+        for (unsigned t = 0; t < threads.size(); ++t)
+            threads[t].join();
+    }
+    TH1::AddDirectory(addDirectory);
+
+    mergedHistograms& merged = sets[0];
+    for (unsigned i = 0; i < merged.paths.size(); ++i)
+    {
+        if (merged.nFiles[i] < nFiles)
+            merged.messages.push_back(std::string(TString::Format("%s is in %d of %d files.", merged.paths[i].c_str(), merged.nFiles[i], nFiles).Data()));
+    }
+    for (std::set<std::string>::iterator it = merged.skipped.begin(); it != merged.skipped.end(); ++it)
+        cout << "mergeHistogramFiles : " << *it << " is not a histogram, it is not merged." << endl;
+    for (unsigned i = 0; i < merged.messages.size(); ++i)
+        cout << "mergeHistogramFiles : " << merged.messages[i] << endl;
+
+    // write the histograms into the same directories as in the input files
+    TDirectory* currentDirectory = gDirectory;
+    TFile* f = new TFile(outputFileName, "RECREATE");
+    for (unsigned i = 0; i < merged.paths.size(); ++i)
+    {
+        TString path = merged.paths[i].c_str();
+        Ssiz_t slash = path.Last('/');
+        TDirectory* dir = (slash >= 0) ? makeDirectory(f, TString(path(0, slash)).Data()) : f;
+        dir->WriteTObject(merged.histos[i], TString(path(slash + 1, path.Length() - slash - 1)).Data());
+        delete merged.histos[i];
+    }
+    f->Close();
+    delete f;
+    currentDirectory->cd();
+
+    return merged.messages.size();
+}
+
+/*
+ * path of the object of "key" in its file, e.g. "dir/fPt_purity"
+ */
+std::string getKeyPath(TKey* key)
+{
+    std::string path = getDirectoryPath(key->GetMotherDir());
+    if (path.size() > 0)
+        path += "/";
+    return path + key->GetName();
+}
+
+/*
+ * subdirectory "path" of "dir", e.g. "a/b", the directories that do not exist are created
+ */
+TDirectory* makeDirectory(TDirectory* dir, const char* path)
+{
+    TString rest = path;
+    Ssiz_t slash;
+    while (rest.Length() > 0)
+    {
+        slash = rest.First('/');
+        TString dirName = (slash >= 0) ? TString(rest(0, slash)) : rest;
+        rest = (slash >= 0) ? TString(rest(slash + 1, rest.Length() - slash - 1)) : TString("");
+        if (dirName.Length() == 0)
+            continue;
+
+        TDirectory* subdir = dir->GetDirectory(dirName.Data());
+        dir = (subdir != NULL) ? subdir : dir->mkdir(dirName.Data());
+    }
+    return dir;
+}
+
+/*
+ * path of "dir" in its file, e.g. "a/b", empty for the top directory of the file or for NULL
+ */
+std::string getDirectoryPath(TDirectory* dir)
+{
+    if (dir == NULL)
+        return "";
+
+    TString dirPath = dir->GetPath();      // "file.root:/a/b"
+    Ssiz_t i = dirPath.Index(":/");
+    if (i < 0)
+        return "";
+    return TString(dirPath(i + 2, dirPath.Length() - i - 2)).Data();
+}
+
+/*
+ * add histogram "h", which is the sum over "nFiles" files of "source", to the histogram with the same path in "merged".
+ * "h" is owned by "merged" after this call.
+ */
+void addToMergedHistograms(mergedHistograms* merged, const std::string& path, TH1* h, int nFiles, const std::string& source)
+{
+    std::map<std::string, int>::iterator it = merged->index.find(path);
+    if (it == merged->index.end())
+    {
+        merged->index[path] = merged->paths.size();
+        merged->paths.push_back(path);
+        merged->histos.push_back(h);
+        merged->nFiles.push_back(nFiles);
+        return;
+    }
+
+    int i = it->second;
+    if (compareBinning(merged->histos[i], h))
+    {
+        merged->histos[i]->Add(h);
+        merged->nFiles[i] += nFiles;
+    }
+    else
+    {
+        merged->messages.push_back(std::string(TString::Format("%s in %s has a different binning than in %s, it is not added.",
+                                                               path.c_str(), source.c_str(), merged->source.c_str()).Data()));
+    }
+    delete h;
+}
+
+/*
+ * read the histograms of the files [first, last) of "fileNames" and add them into "merged", run by a worker thread
+ */
+void readHistogramFiles(int first, int last, const char* fileNames[], mergedHistograms* merged)
+{
+    merged->source = (last - first > 1) ? TString::Format("%s ... %s", fileNames[first], fileNames[last-1]).Data() : fileNames[first];
+
+    for (int i = first; i < last; ++i)
+    {
+        TFile* file = TFile::Open(fileNames[i], "READ");
+        if (file == NULL || file->IsZombie())
+        {
+            merged->messages.push_back(std::string(TString::Format("%s cannot be opened, it is not merged.", fileNames[i]).Data()));
+            delete file;
+            continue;
+        }
+
+        TList* keys = getListOfALLKeys(file);
+        std::set<std::string> paths;
+        TIter iter(keys);
+        TKey* key;
+        while ((key=(TKey*)iter.Next()))
+        {
+            if (strcmp(key->GetClassName(), "TDirectoryFile") == 0)
+                continue;
+            // keys with several cycles are listed from the highest cycle
+            std::string path = getKeyPath(key);
+            if (!paths.insert(path).second)
+                continue;
+
+            TClass* objClass = TClass::GetClass(key->GetClassName());
+            if (objClass == NULL || !objClass->InheritsFrom("TH1"))
+            {
+                merged->skipped.insert(path);
+                continue;
+            }
+            addToMergedHistograms(merged, path, (TH1*)key->ReadObj(), 1, fileNames[i]);
+        }
+        delete keys;
+        file->Close();
+        delete file;
+    }
+}
+
+/*
+ * add the histograms of "other" to "merged", "other" is empty after this call
+ */
+void mergeHistogramSets(mergedHistograms* merged, mergedHistograms* other)
+{
+    for (unsigned i = 0; i < other->paths.size(); ++i)
+        addToMergedHistograms(merged, other->paths[i], other->histos[i], other->nFiles[i], other->source);
+
+    merged->skipped.insert(other->skipped.begin(), other->skipped.end());
+    merged->messages.insert(merged->messages.end(), other->messages.begin(), other->messages.end());
+    merged->source += ", " + other->source;
+
+    other->paths.clear();
+    other->index.clear();
+    other->histos.clear();
+    other->nFiles.clear();
+}
+
 /*
  * save recursively all the TH1 histograms inside a TDirectoryFile "dir" to images
  */
@@ -394,9 +674,9 @@ void saveAllHistogramsToPicture(TDirectoryFile* dir, const char* fileType /* ="g
 
     TH1*  h;
     TKey*  key;
-    TIter* iter = new TIter(keysHisto);
+    TIter iter(keysHisto);
     TCanvas* c1=new TCanvas();
-    while ((key=(TKey*)iter->Next()))
+    while ((key=(TKey*)iter.Next()))
     {
         h = (TH1*)key->ReadObj();
 
@@ -487,9 +767,9 @@ void saveAllGraphsToPicture(TDirectoryFile* dir, const char* fileType /* ="gif"
 
     TGraph* graph;
     TKey*  key;
-    TIter* iter = new TIter(keysGraph);
+    TIter iter(keysGraph);
     TCanvas* c1=new TCanvas();
-    while ((key=(TKey*)iter->Next()))
+    while ((key=(TKey*)iter.Next()))
     {
         graph = (TGraph*)key->ReadObj();
 
@@ -568,8 +848,8 @@ void saveAllGraphsToPicture(TDirectoryFile* dir, const char* fileType /* ="gif"
 void saveAllCanvasesToPicture(TList* canvases, const char* fileType /* ="gif" */, const char* directoryToBeSavedIn /* ="" */)
 {
     TCanvas* c;
-    TIter* iter = new TIter(canvases);
-    while ((c=(TCanvas*)iter->Next()))
+    TIter iter(canvases);
+    while ((c=(TCanvas*)iter.Next()))
     {
         if(strcmp(directoryToBeSavedIn, "") == 0)   // save in the current directory if no directory is specified
         {
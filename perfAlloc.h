@@ -0,0 +1,96 @@
+/*
+ * perfAlloc.h
+ *
+ * replacements of the global operator new and delete that count the heap allocations of each thread,
+ * see perfThreadAllocations() and PerfStats in perfUtil.h.
+ *
+ * The replacements are defined only if HIUTILS_PERF_ALLOC is defined at compile time, e.g. "g++ -DHIUTILS_PERF -DHIUTILS_PERF_ALLOC ...".
+ * A program can replace operator new and delete only once, so this file must be included by the translation unit
+ * of the main program only, as in the compiled test and benchmark macros. It is not included by any other header
+ * and must not be loaded in the ROOT interpreter.
+ *
+ * Over-aligned allocations (C++17 operator new with std::align_val_t) are counted as well.
+ *
+ * usage :
+ *  #include "perfUtil.h"
+ *  #include "perfAlloc.h"     // in the file of main() only
+ */
+
+#ifndef PERFALLOC_H_
+#define PERFALLOC_H_
+
+#include "perfUtil.h"
+
+#include <new>
+#include <cstdlib>
+
+#ifdef HIUTILS_PERF_ALLOC
+void* operator new(size_t size)
+{
+    perfThreadAllocations()++;
+    void* p = malloc((size > 0) ? size : 1);
+    if (p == NULL)  throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    perfThreadAllocations()++;
+    return malloc((size > 0) ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    perfThreadAllocations()++;
+    return malloc((size > 0) ? size : 1);
+}
+
+void operator delete(void* p) noexcept          { free(p); }
+void operator delete[](void* p) noexcept        { free(p); }
+void operator delete(void* p, size_t) noexcept  { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#ifdef __cpp_aligned_new
+/*
+ * memory of posix_memalign() is released by free(), so the aligned and the other allocations share operator delete
+ */
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    perfThreadAllocations()++;
+    // posix_memalign() needs a multiple of the size of a pointer
+    size_t align = ((size_t)alignment > sizeof(void*)) ? (size_t)alignment : sizeof(void*);
+    void* p = NULL;
+    if (posix_memalign(&p, align, (size > 0) ? size : 1) != 0)  return NULL;
+    return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    void* p = operator new(size, alignment, std::nothrow);
+    if (p == NULL)  throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept            { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept          { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept    { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept  { free(p); }
+#endif
+#endif
+
+#endif /* PERFALLOC_H_ */
@@ -0,0 +1,478 @@
+/*
+ * perfUtil.h
+ *
+ * utilities to instrument hot code paths : scoped timers and counters per stage, bytes read per tree and
+ * throughput reporting (events/s, estimated time left) through a progress callback.
+ *
+ * Instrumentation is enabled only if HIUTILS_PERF is defined at compile time, e.g. "g++ -DHIUTILS_PERF ...".
+ * Otherwise the PERF_* macros expand to nothing and the instrumented code has no overhead.
+ *
+ * If HIUTILS_PERF_ALLOC is defined as well, heap allocations are counted per stage and per "progress interval" of entries,
+ * e.g. to check that an event loop does not allocate once it has reached its steady state.
+ * The allocations are counted by the replacements of the global operator new and delete in perfAlloc.h, which must be
+ * included by the file of main() only. Allocations are counted per thread : a stage counts the
+ * allocations of the thread that runs it, not the ones of background threads, e.g. of ClusterPrefetcher.
+ */
+
+#ifndef PERFUTIL_H_
+#define PERFUTIL_H_
+
+#include <TString.h>
+#include <TTree.h>
+#include <TBranch.h>
+#include <TTreePerfStats.h>
+#include <TH1D.h>
+#include <TDirectory.h>
+#include <TMath.h>
+
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+#ifdef HIUTILS_PERF
+#define PERF_SCOPED_TIMER(perf, stage)          PerfScopedTimer perfScopedTimer_##stage((perf), (stage))
+#define PERF_COUNT(perf, stage, n)              do { if ((perf) != NULL) (perf)->count((stage), (n)); } while (0)
+#define PERF_ADD_BYTES(perf, treeIndex, bytes)  do { if ((perf) != NULL) (perf)->addBytes((treeIndex), (bytes)); } while (0)
+#define PERF_START_LOOP(perf, entries)          do { if ((perf) != NULL) (perf)->startLoop(entries); } while (0)
+#define PERF_PROGRESS(perf, entry)              do { if ((perf) != NULL) (perf)->progress(entry); } while (0)
+#define PERF_STOP_LOOP(perf)                    do { if ((perf) != NULL) (perf)->stopLoop(); } while (0)
+#else
+#define PERF_SCOPED_TIMER(perf, stage)
+#define PERF_COUNT(perf, stage, n)
+#define PERF_ADD_BYTES(perf, treeIndex, bytes)
+#define PERF_START_LOOP(perf, entries)
+#define PERF_PROGRESS(perf, entry)
+#define PERF_STOP_LOOP(perf)
+#endif
+
+/*
+ * number of heap allocations made by the calling thread so far, counted only if HIUTILS_PERF_ALLOC is defined
+ * and perfAlloc.h is included
+ */
+inline Long64_t& perfThreadAllocations()
+{
+    static thread_local Long64_t allocations = 0;
+    return allocations;
+}
+
+/*
+ * function called every "interval" entries of an instrumented loop.
+ * "entry" is the number of entries processed so far, "entries" is the total number of entries in the loop.
+ */
+typedef void (*perfProgressCallback)(Long64_t entry, Long64_t entries, double eventsPerSecond, double secondsLeft, void* userData);
+
+void printPerfProgress(Long64_t entry, Long64_t entries, double eventsPerSecond, double secondsLeft, void* userData);
+
+class PerfStats {
+public:
+    PerfStats(int nStages, const char* const stageNames[]);
+    virtual ~PerfStats();
+
+    void     addTime(int stage, double seconds);
+    void     addAllocations(int stage, Long64_t n);
+    void     count(int stage, Long64_t n = 1);
+    int      addTree(TTree* tree, const char* name);
+    void     addBytes(int treeIndex, Long64_t bytes);
+    void     setProgressCallback(perfProgressCallback callback, void* userData = NULL, Long64_t interval = 100000);
+    void     startLoop(Long64_t entries);
+    void     progress(Long64_t entry);
+    void     stopLoop();
+    double   getEventsPerSecond() const;
+    Long64_t getStageAllocations(int stage) const;
+    Long64_t getSteadyAllocations() const;
+    Long64_t getSteadyEntries() const;
+    void     reset();
+    void     print() const;
+    void     write(TDirectory* dir) const;
+
+    static double now();
+    static bool   countsAllocations();
+
+private:
+    std::vector<TString>  stageNames;
+    std::vector<double>   stageTime;        // seconds spent in each stage
+    std::vector<Long64_t> stageCalls;       // number of timed calls of each stage
+    std::vector<Long64_t> stageCounts;      // counters of each stage, e.g. number of objects processed
+    std::vector<Long64_t> stageAllocations; // heap allocations in each stage
+
+    std::vector<TString>  treeNames;
+    std::vector<TTree*>   trees;
+    std::vector<Long64_t> treeBytes;        // uncompressed bytes read from each tree
+    std::vector<double>   treeZipRatio;     // compressed / uncompressed size of the active branches of each tree
+    TTreePerfStats* filePerfStats;          // basket decompression time and compressed bytes read of all trees together
+    void     updateZipRatios();
+
+    perfProgressCallback  progressCallback;
+    void*    progressUserData;
+    Long64_t progressInterval;
+
+    Long64_t loopEntries;       // entries of the current loop
+    double   loopStart;
+    Long64_t totalEntries;      // entries of all finished loops
+    double   totalTime;         // time of all finished loops
+
+    // heap allocations of the loops in each interval of "progressInterval" entries.
+    // The first interval of a loop is the warm-up, the other intervals are the steady state.
+    std::vector<Long64_t> intervalAllocations;
+    Long64_t intervalStartEntry;
+    Long64_t intervalStartAllocations;
+    Long64_t steadyAllocations;
+    Long64_t steadyEntries;
+    void     endInterval(Long64_t entry);
+};
+
+/*
+ * adds the time between its construction and destruction to "stage" of "perf".
+ * does nothing if "perf" is NULL.
+ */
+class PerfScopedTimer {
+public:
+    PerfScopedTimer(PerfStats* perf, int stage) : perf(perf), stage(stage), start(0), startAllocations(0) {
+        if (perf != NULL) {
+            start = PerfStats::now();
+            startAllocations = perfThreadAllocations();
+        }
+    }
+    ~PerfScopedTimer() {
+        if (perf != NULL) {
+            perf->addTime(stage, PerfStats::now() - start);
+            perf->addAllocations(stage, perfThreadAllocations() - startAllocations);
+        }
+    }
+
+private:
+    PerfStats* perf;
+    int        stage;
+    double     start;
+    Long64_t   startAllocations;
+};
+
+PerfStats::PerfStats(int nStages, const char* const stageNames[]) :
+        stageTime(nStages, 0), stageCalls(nStages, 0), stageCounts(nStages, 0), stageAllocations(nStages, 0),
+        filePerfStats(NULL), progressCallback(printPerfProgress), progressUserData(NULL), progressInterval(100000),
+        loopEntries(0), loopStart(0), totalEntries(0), totalTime(0),
+        intervalStartEntry(0), intervalStartAllocations(0), steadyAllocations(0), steadyEntries(0)
+{
+    for (int i = 0; i < nStages; ++i) {
+        this->stageNames.push_back(stageNames[i]);
+    }
+}
+
+PerfStats::~PerfStats()
+{
+    delete filePerfStats;
+}
+
+/*
+ * monotonic time in seconds
+ */
+double PerfStats::now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PerfStats::addTime(int stage, double seconds)
+{
+    stageTime[stage] += seconds;
+    stageCalls[stage]++;
+}
+
+/*
+ * true if the program is compiled with HIUTILS_PERF_ALLOC, i.e. heap allocations are counted
+ */
+bool PerfStats::countsAllocations()
+{
+#ifdef HIUTILS_PERF_ALLOC
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PerfStats::addAllocations(int stage, Long64_t n)
+{
+    stageAllocations[stage] += n;
+}
+
+void PerfStats::count(int stage, Long64_t n)
+{
+    stageCounts[stage] += n;
+}
+
+/*
+ * register a tree whose read bytes are to be reported. returns the index to be used with addBytes().
+ * A TTreePerfStats object is attached to the first tree to measure the basket decompression time. It is the global
+ * gPerfStats, so it counts the reads of every tree and is a total of the file, not of the first tree only.
+ * The compressed bytes read from a tree are estimated from its bytes read and the compression of its active branches.
+ */
+int PerfStats::addTree(TTree* tree, const char* name)
+{
+    treeNames.push_back(name);
+    trees.push_back(tree);
+    treeBytes.push_back(0);
+    treeZipRatio.push_back(0);
+    if (filePerfStats == NULL && tree != NULL) {
+        filePerfStats = new TTreePerfStats("perfStats", tree);
+    }
+
+    return (int)trees.size() - 1;
+}
+
+void PerfStats::addBytes(int treeIndex, Long64_t bytes)
+{
+    treeBytes[treeIndex] += bytes;
+}
+
+/*
+ * "callback" is called every "interval" entries. callback = NULL disables progress reporting,
+ * but heap allocations are still counted per "interval" entries.
+ */
+void PerfStats::setProgressCallback(perfProgressCallback callback, void* userData, Long64_t interval)
+{
+    progressCallback = callback;
+    progressUserData = userData;
+    progressInterval = (interval > 0) ? interval : 1;
+}
+
+void PerfStats::startLoop(Long64_t entries)
+{
+    loopEntries = entries;
+    loopStart = now();
+    intervalStartEntry = 0;
+    intervalStartAllocations = perfThreadAllocations();
+}
+
+/*
+ * "entry" is the number of entries processed since startLoop()
+ */
+void PerfStats::progress(Long64_t entry)
+{
+    if (entry % progressInterval != 0)  return;
+    if (entry > 0)  endInterval(entry);
+    if (progressCallback == NULL)  return;
+
+    double elapsed = now() - loopStart;
+    double eventsPerSecond = (elapsed > 0) ? entry / elapsed : 0;
+    double secondsLeft = (eventsPerSecond > 0) ? (loopEntries - entry) / eventsPerSecond : -1;
+
+    progressCallback(entry, loopEntries, eventsPerSecond, secondsLeft, progressUserData);
+}
+
+void PerfStats::stopLoop()
+{
+    if (loopEntries > intervalStartEntry)  endInterval(loopEntries);
+    totalEntries += loopEntries;
+    totalTime += now() - loopStart;
+    updateZipRatios();
+}
+
+/*
+ * compression of each tree, as TBranch::GetZipBytes() / TBranch::GetTotBytes() of the branches that are read.
+ * It is computed at the end of a loop, when the trees still exist and their active branches are the ones of the loop.
+ */
+void PerfStats::updateZipRatios()
+{
+    for (unsigned i = 0; i < trees.size(); ++i) {
+        if (trees[i] == NULL)  continue;
+
+        Long64_t totBytes = 0;
+        Long64_t zipBytes = 0;
+        TIter iter(trees[i]->GetListOfBranches());
+        TObject* obj;
+        while ((obj = iter.Next())) {
+            TBranch* branch = (TBranch*)obj;
+            if (!trees[i]->GetBranchStatus(branch->GetName()))  continue;
+            totBytes += branch->GetTotBytes("*");
+            zipBytes += branch->GetZipBytes("*");
+        }
+        if (totBytes > 0)  treeZipRatio[i] = (double)zipBytes / totBytes;
+    }
+}
+
+/*
+ * record the allocations of the entries since the start of the current interval, up to "entry"
+ */
+void PerfStats::endInterval(Long64_t entry)
+{
+    Long64_t allocations = perfThreadAllocations() - intervalStartAllocations;
+    intervalAllocations.push_back(allocations);
+    if (intervalStartEntry > 0) {
+        steadyAllocations += allocations;
+        steadyEntries += entry - intervalStartEntry;
+    }
+
+    intervalStartEntry = entry;
+    // the allocations of the progress callback are not counted
+    intervalStartAllocations = perfThreadAllocations();
+}
+
+double PerfStats::getEventsPerSecond() const
+{
+    if (totalTime <= 0)  return 0;
+
+    return totalEntries / totalTime;
+}
+
+/*
+ * heap allocations in "stage", 0 unless compiled with HIUTILS_PERF_ALLOC
+ */
+Long64_t PerfStats::getStageAllocations(int stage) const
+{
+    return stageAllocations[stage];
+}
+
+/*
+ * heap allocations of the loops after their first "progress interval" of entries, i.e. once the loops are warmed up.
+ * 0 unless compiled with HIUTILS_PERF_ALLOC.
+ */
+Long64_t PerfStats::getSteadyAllocations() const
+{
+    return steadyAllocations;
+}
+
+/*
+ * number of entries counted by getSteadyAllocations()
+ */
+Long64_t PerfStats::getSteadyEntries() const
+{
+    return steadyEntries;
+}
+
+void PerfStats::reset()
+{
+    for (unsigned i = 0; i < stageNames.size(); ++i) {
+        stageTime[i] = 0;
+        stageCalls[i] = 0;
+        stageCounts[i] = 0;
+        stageAllocations[i] = 0;
+    }
+    for (unsigned i = 0; i < trees.size(); ++i) {
+        treeBytes[i] = 0;
+    }
+    loopEntries = 0;
+    totalEntries = 0;
+    totalTime = 0;
+    intervalAllocations.clear();
+    steadyAllocations = 0;
+    steadyEntries = 0;
+}
+
+/*
+ * print a summary table of the stages and of the trees
+ */
+void PerfStats::print() const
+{
+    double totalTime = 0;
+    for (unsigned i = 0; i < stageNames.size(); ++i) {
+        totalTime += stageTime[i];
+    }
+
+    std::cout << std::left << std::setw(24) << "stage" << std::right << std::setw(14) << "calls" << std::setw(14) << "counts"
+              << std::setw(14) << "time (s)" << std::setw(10) << "time (%)" << std::setw(16) << "time/call (us)";
+    if (countsAllocations())  std::cout << std::setw(14) << "allocations";
+    std::cout << std::endl;
+    for (unsigned i = 0; i < stageNames.size(); ++i) {
+        std::cout << std::left << std::setw(24) << stageNames[i].Data() << std::right
+                  << std::setw(14) << stageCalls[i] << std::setw(14) << stageCounts[i]
+                  << std::setw(14) << std::setprecision(4) << stageTime[i]
+                  << std::setw(10) << std::setprecision(3) << ((totalTime > 0) ? 100 * stageTime[i] / totalTime : 0)
+                  << std::setw(16) << std::setprecision(4) << ((stageCalls[i] > 0) ? 1e6 * stageTime[i] / stageCalls[i] : 0);
+        if (countsAllocations())  std::cout << std::setw(14) << stageAllocations[i];
+        std::cout << std::endl;
+    }
+
+    std::cout << std::left << std::setw(24) << "tree" << std::right << std::setw(20) << "bytes read"
+              << std::setw(20) << "zipped bytes read" << std::endl;
+    for (unsigned i = 0; i < trees.size(); ++i) {
+        std::cout << std::left << std::setw(24) << treeNames[i].Data() << std::right
+                  << std::setw(20) << treeBytes[i]
+                  << std::setw(20) << (Long64_t)(treeBytes[i] * treeZipRatio[i]) << std::endl;
+    }
+    if (filePerfStats != NULL) {
+        std::cout << "all trees : zipped bytes read = " << filePerfStats->GetBytesRead()
+                  << ", unzip time = " << std::setprecision(4) << filePerfStats->GetUnzipTime() << " s" << std::endl;
+    }
+
+    std::cout << "entries processed = " << totalEntries << ", loop time = " << totalTime << " s, "
+              << getEventsPerSecond() << " events/s" << std::endl;
+    if (countsAllocations()) {
+        std::cout << "heap allocations per " << progressInterval << " entries :";
+        for (unsigned i = 0; i < intervalAllocations.size(); ++i) {
+            std::cout << " " << intervalAllocations[i];
+        }
+        std::cout << std::endl;
+        std::cout << "steady state : " << steadyAllocations << " allocations in " << steadyEntries << " entries" << std::endl;
+    }
+    std::cout << std::setprecision(6);
+}
+
+/*
+ * write the summary table into "dir" as histograms whose bins are labeled by stage or tree name
+ */
+void PerfStats::write(TDirectory* dir) const
+{
+    dir->cd();
+
+    const int nStages = stageNames.size();
+    TH1D* hTime   = new TH1D("perfStageTime",   "time per stage;;time (s)", nStages, 0, nStages);
+    TH1D* hCalls  = new TH1D("perfStageCalls",  "calls per stage;;calls",   nStages, 0, nStages);
+    TH1D* hCounts = new TH1D("perfStageCounts", "counts per stage;;counts", nStages, 0, nStages);
+    for (int i = 0; i < nStages; ++i) {
+        hTime->GetXaxis()->SetBinLabel(i+1, stageNames[i].Data());
+        hCalls->GetXaxis()->SetBinLabel(i+1, stageNames[i].Data());
+        hCounts->GetXaxis()->SetBinLabel(i+1, stageNames[i].Data());
+        hTime->SetBinContent(i+1, stageTime[i]);
+        hCalls->SetBinContent(i+1, stageCalls[i]);
+        hCounts->SetBinContent(i+1, stageCounts[i]);
+    }
+
+    const int nTrees = trees.size();
+    if (nTrees > 0) {
+        TH1D* hBytes     = new TH1D("perfTreeBytesRead",    "bytes read per tree;;bytes",        nTrees, 0, nTrees);
+        TH1D* hZipBytes  = new TH1D("perfTreeZipBytesRead", "zipped bytes read per tree;;bytes", nTrees, 0, nTrees);
+        for (int i = 0; i < nTrees; ++i) {
+            hBytes->GetXaxis()->SetBinLabel(i+1, treeNames[i].Data());
+            hZipBytes->GetXaxis()->SetBinLabel(i+1, treeNames[i].Data());
+            hBytes->SetBinContent(i+1, treeBytes[i]);
+            hZipBytes->SetBinContent(i+1, treeBytes[i] * treeZipRatio[i]);
+        }
+        hBytes->Write();
+        hZipBytes->Write();
+    }
+    // decompression time and compressed bytes read of all trees together
+    if (filePerfStats != NULL)  filePerfStats->Write();
+
+    hTime->Write();
+    hCalls->Write();
+    hCounts->Write();
+
+    if (countsAllocations()) {
+        TH1D* hAllocations = new TH1D("perfStageAllocations", "heap allocations per stage;;allocations", nStages, 0, nStages);
+        for (int i = 0; i < nStages; ++i) {
+            hAllocations->GetXaxis()->SetBinLabel(i+1, stageNames[i].Data());
+            hAllocations->SetBinContent(i+1, stageAllocations[i]);
+        }
+        const int nIntervals = intervalAllocations.size();
+        TH1D* hIntervals = new TH1D("perfLoopAllocations", Form("heap allocations per %lld entries;interval;allocations", progressInterval),
+                                    TMath::Max(nIntervals, 1), 0, TMath::Max(nIntervals, 1));
+        for (int i = 0; i < nIntervals; ++i) {
+            hIntervals->SetBinContent(i+1, intervalAllocations[i]);
+        }
+        hAllocations->Write();
+        hIntervals->Write();
+    }
+}
+
+/*
+ * default progress callback, replaces the "current entry = ..." printout of the event loops.
+ */
+void printPerfProgress(Long64_t entry, Long64_t entries, double eventsPerSecond, double secondsLeft, void* userData)
+{
+    std::cout << "current entry = " << entry << " out of " << entries << " : "
+              << std::setprecision(3) << ((entries > 0) ? (double)entry/entries*100 : 0) << " %, "
+              << eventsPerSecond << " events/s, ETA = " << secondsLeft << " s" << std::endl;
+    std::cout << std::setprecision(6);
+}
+
+#endif /* PERFUTIL_H_ */
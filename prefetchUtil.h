@@ -0,0 +1,201 @@
+/*
+ * prefetchUtil.h
+ *
+ * background read-ahead of the baskets of a set of branches.
+ *
+ * A ClusterPrefetcher reads the compressed baskets of upcoming entries on a separate thread, so that the file system
+ * (page cache of a network file system, e.g. /mnt/hadoop) already holds them when the event loop asks for them.
+ * The thread reads the file with its own file descriptor and does not call ROOT, the event loop only reports its
+ * current entry through setEntry().
+ *
+ * Only files that are accessible through the local file system can be prefetched, e.g. not "root://" URLs.
+ */
+
+#ifndef PREFETCHUTIL_H_
+#define PREFETCHUTIL_H_
+
+#include <TBranch.h>
+#include <TTree.h>
+#include <TFile.h>
+#include <TString.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+
+class ClusterPrefetcher {
+public:
+    ClusterPrefetcher(const char* fileName, Long64_t lookAheadEntries);
+    virtual ~ClusterPrefetcher();
+
+    void     addBranch(TBranch* branch);
+    bool     start();
+    void     stop();
+    void     setEntry(Long64_t entry);
+    Long64_t getBytesPrefetched() const;
+
+private:
+    // byte range of a basket in the file and the entries it holds
+    struct basketRange {
+        Long64_t firstEntry;
+        Long64_t lastEntry;     // last entry + 1
+        Long64_t seek;
+        Int_t    bytes;
+        bool operator<(const basketRange& other) const { return firstEntry < other.firstEntry; }
+    };
+
+    void run();
+
+    TString  fileName;
+    Long64_t lookAheadEntries;
+    std::vector<basketRange> baskets;     // sorted by first entry
+
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable condition;
+    std::atomic<Long64_t>   currentEntry;
+    std::atomic<Long64_t>   wakeUpEntry;    // entry at which the waiting thread has a basket to prefetch
+    std::atomic<bool>       stopRequested;
+    std::atomic<Long64_t>   bytesPrefetched;
+    bool                    running;
+};
+
+/*
+ * baskets holding entries up to "lookAheadEntries" after the current entry are prefetched.
+ */
+ClusterPrefetcher::ClusterPrefetcher(const char* fileName, Long64_t lookAheadEntries) :
+        fileName(fileName), lookAheadEntries(lookAheadEntries),
+        currentEntry(0), wakeUpEntry(kMaxLong64), stopRequested(false), bytesPrefetched(0), running(false)
+{
+}
+
+ClusterPrefetcher::~ClusterPrefetcher()
+{
+    stop();
+}
+
+/*
+ * register the baskets of "branch" to be prefetched. must be called before start().
+ */
+void ClusterPrefetcher::addBranch(TBranch* branch)
+{
+    Int_t     nBaskets = branch->GetWriteBasket();
+    Long64_t* basketEntry = branch->GetBasketEntry();
+    Int_t*    basketBytes = branch->GetBasketBytes();
+    Long64_t  entries = branch->GetEntries();
+
+    for (int i = 0; i < nBaskets; ++i) {
+        basketRange range;
+        range.firstEntry = basketEntry[i];
+        range.lastEntry  = (i+1 < nBaskets) ? basketEntry[i+1] : entries;
+        range.seek  = branch->GetBasketSeek(i);
+        range.bytes = basketBytes[i];
+        // baskets that are not written to the file have no seek
+        if (range.seek > 0 && range.bytes > 0) {
+            baskets.push_back(range);
+        }
+    }
+}
+
+/*
+ * start the prefetching thread. returns false if the file cannot be read through the local file system.
+ */
+bool ClusterPrefetcher::start()
+{
+    if (running)  return true;
+
+    if (fileName.Contains("://") && !fileName.BeginsWith("file://")) {
+        std::cout << "ClusterPrefetcher : " << fileName.Data() << " is not a local file, prefetching is disabled." << std::endl;
+        return false;
+    }
+
+    std::sort(baskets.begin(), baskets.end());
+    stopRequested = false;
+    running = true;
+    thread = std::thread(&ClusterPrefetcher::run, this);
+    return true;
+}
+
+void ClusterPrefetcher::stop()
+{
+    if (!running)  return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    condition.notify_one();
+    thread.join();
+    running = false;
+}
+
+/*
+ * called by the event loop for every entry. The thread is woken up only when the entry reaches the boundary
+ * of the next basket to prefetch. The notification is sent under the lock, so that it cannot be lost
+ * between the check of the boundary by the thread and its wait.
+ */
+void ClusterPrefetcher::setEntry(Long64_t entry)
+{
+    currentEntry.store(entry);
+    if (entry >= wakeUpEntry.load()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeUpEntry = kMaxLong64;
+        condition.notify_one();
+    }
+}
+
+Long64_t ClusterPrefetcher::getBytesPrefetched() const
+{
+    return bytesPrefetched;
+}
+
+void ClusterPrefetcher::run()
+{
+    TString path = fileName;
+    if (path.BeginsWith("file://"))  path.Remove(0, 7);
+
+    int fd = open(path.Data(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "ClusterPrefetcher : cannot open " << path.Data() << ", prefetching is disabled." << std::endl;
+        return;
+    }
+
+    std::vector<char> buffer;
+    unsigned next = 0;      // next basket to prefetch
+    while (next < baskets.size())
+    {
+        {
+            // wait until the event loop comes close enough to the next basket
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUpEntry = baskets[next].firstEntry - lookAheadEntries;
+            condition.wait(lock, [&] {
+                return stopRequested || baskets[next].firstEntry <= currentEntry.load() + lookAheadEntries;
+            });
+            wakeUpEntry = kMaxLong64;
+            if (stopRequested)  break;
+        }
+
+        Long64_t limit = currentEntry.load(std::memory_order_relaxed) + lookAheadEntries;
+        while (next < baskets.size() && baskets[next].firstEntry <= limit && !stopRequested)
+        {
+            // baskets that the event loop has already passed are not read
+            if (baskets[next].lastEntry > currentEntry.load(std::memory_order_relaxed)) {
+                if ((Int_t)buffer.size() < baskets[next].bytes)  buffer.resize(baskets[next].bytes);
+                ssize_t n = pread(fd, &buffer[0], baskets[next].bytes, baskets[next].seek);
+                if (n > 0)  bytesPrefetched += n;
+            }
+            ++next;
+        }
+    }
+
+    close(fd);
+}
+
+#endif /* PREFETCHUTIL_H_ */
@@ -5,10 +5,13 @@
 #include <TMath.h>
 
 #include <iostream>
+#include <cmath>
 
 Double_t getDR( Double_t eta1, Double_t phi1, Double_t eta2, Double_t phi2);
 Double_t getDPHI( Double_t phi1, Double_t phi2);
 Double_t getDETA(Double_t eta1, Double_t eta2);
+void     getPhotonJetPairs(float photonPt, float photonEta, float photonPhi, int nJets, const float* jetPt, const float* jetEta, const float* jetPhi,
+                           float* xJ, float* dphi, float* deta, float* dR);
 
 using  std::cout;
 using  std::endl;
@@ -44,4 +47,32 @@ Double_t getDETA(Double_t eta1, Double_t eta2){
 	return eta1 - eta2;
 }
 
+/*
+ * observables of a photon paired with each of "nJets" jets :
+ * xJ = jet pT / photon pT, dphi = |photon phi - jet phi| in [0, pi], deta = photon eta - jet eta, dR = sqrt(dphi^2 + deta^2)
+ * Output arrays must hold "nJets" elements.
+ *
+ * The loop has no branches and no function calls other than sqrt, so that the compiler can vectorize it.
+ * dphi is the same as |getDPHI(photonPhi, jetPhi)| for angles in [-pi, pi].
+ */
+void getPhotonJetPairs(float photonPt, float photonEta, float photonPhi, int nJets, const float* jetPt, const float* jetEta, const float* jetPhi,
+                       float* xJ, float* dphi, float* deta, float* dR)
+{
+    const float pi = 3.141592653589;
+    const float twoPi = 2 * pi;
+    const float invPt = (photonPt != 0) ? 1 / photonPt : 0;
+
+    for (int i = 0; i < nJets; ++i) {
+        float dp = photonPhi - jetPhi[i];
+        dp = dp - twoPi * (dp > pi) + twoPi * (dp <= -pi);
+        dp = std::fabs(dp);
+        float de = photonEta - jetEta[i];
+
+        xJ[i]   = jetPt[i] * invPt;
+        dphi[i] = dp;
+        deta[i] = de;
+        dR[i]   = std::sqrt(dp * dp + de * de);
+    }
+}
+
 #endif /* SMALLPHOTONUTIL_H_ */
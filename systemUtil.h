@@ -12,14 +12,50 @@
 #include <TSystemDirectory.h>
 #include <TSystemFile.h>
 #include <TObjString.h>
+#include <TFile.h>
+#include <TKey.h>
+#include <TTree.h>
+#include <TROOT.h>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fnmatch.h>
 
 #include <vector>
 #include <string>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <iostream>
 
+// a file found by getInputFiles()
+struct inputFileInfo {
+    std::string path;
+    Long64_t    size;
+    Long64_t    mtime;      // modification time, seconds since epoch
+    bool        entriesCounted;
+    std::vector<std::string> treeNames;     // path of each tree in the file, e.g. "hiEvtAnalyzer/HiTree"
+    std::vector<Long64_t>    treeEntries;
+};
 
 TList*                   getFileNamesList(const char* dirname=".", const char* ext="");
 std::vector<std::string> getFileNames    (const char* dirname=".", const char* ext="");
+std::vector<inputFileInfo> getInputFiles(const char* dirname=".", const char* pattern="*.root", bool countEntries=false,
+                                         const char* manifestFileName=NULL, int nThreads=0);
+Long64_t getTreeEntries(const inputFileInfo& info, const char* treeName);
+std::vector<std::vector<int> > balanceInputFiles(const std::vector<inputFileInfo>& files, int nParts, const char* treeName="");
+bool     matchFileName(const char* fileName, const char* pattern);
+void     findFilesInDirectories(std::deque<std::string>* dirs, int* nActive, std::mutex* mutex, std::condition_variable* condition,
+                                const char* pattern, std::vector<inputFileInfo>* files);
+void     countTreeEntries(TDirectory* dir, const std::string& prefix, inputFileInfo* info);
+std::map<std::string, inputFileInfo> readInputManifest(const char* manifestFileName);
+void     writeInputManifest(const char* manifestFileName, const std::vector<inputFileInfo>& files);
 
 using  std::cout;
 using  std::endl;
@@ -53,15 +89,17 @@ TList* getFileNamesList(const char* dirname /* ="." */, const char* ext /* ="" *
       TSystemFile *file;
       // TString cannot be stored in a TCollection... use TObjString instead.
       // https://root.cern.ch/root/htmldoc/TString.html
-      TObjString* fname;
       TIter next(files);
       while ((file=(TSystemFile*)next())) {
-         fname = new TObjString(file->GetName());
-         if (fname->GetString().EndsWith(ext)) {
-//            cout << fname->GetString().Data() << endl;
-            	outFileNames->Add(fname);
+         TString fname = file->GetName();
+         if (fname.EndsWith(ext)) {
+//            cout << fname.Data() << endl;
+            	outFileNames->Add(new TObjString(fname.Data()));
          }
       }
+      // the list of files is owned by the caller of GetListOfFiles()
+      files->Delete();
+      delete files;
    }
    else
    {
@@ -86,6 +124,8 @@ std::vector<std::string> getFileNames(const char* dirname /* ="." */, const char
 				outFileNames.push_back(fname.Data());
 			}
 		}
+		files->Delete();
+		delete files;
 	}
 	else
 	{
@@ -95,5 +135,316 @@ std::vector<std::string> getFileNames(const char* dirname /* ="." */, const char
 	return outFileNames;
 }
 
+/*
+ * find the files under "dirname" and its subdirectories whose name matches "pattern", sorted by path.
+ * "pattern" is a glob, e.g. "HiForest_*.root", or an extension, e.g. ".root", if it has no wildcard.
+ * Directories are walked by "nThreads" threads in parallel, nThreads = 0 uses one thread per core.
+ * Symbolic links to files are followed, symbolic links to directories are not.
+ *
+ * The size and the modification time of each file are recorded. If "countEntries" is true, each file is opened
+ * (in parallel as well) and the number of entries of each tree in the file is recorded, see getTreeEntries().
+ *
+ * If "manifestFileName" is given, the result is written to that text file, and the entry counts in the manifest
+ * are reused for the files whose size and modification time did not change, so these files are not opened again.
+ */
+std::vector<inputFileInfo> getInputFiles(const char* dirname /* ="." */, const char* pattern /* ="*.root" */, bool countEntries /* =false */,
+                                         const char* manifestFileName /* =NULL */, int nThreads /* =0 */)
+{
+    if (nThreads <= 0)
+        nThreads = std::thread::hardware_concurrency();
+    nThreads = std::max(nThreads, 1);
+
+    // walk the directories : every thread takes a directory from the queue and adds its subdirectories to the queue
+    std::deque<std::string> dirs(1, dirname);
+    int nActive = 0;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::vector<inputFileInfo> > filesOfThreads(nThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t)
+        threads.push_back(std::thread(findFilesInDirectories, &dirs, &nActive, &mutex, &condition, pattern, &filesOfThreads[t]));
+    for (int t = 0; t < nThreads; ++t)
+        threads[t].join();
+
+    std::vector<inputFileInfo> files;
+    for (int t = 0; t < nThreads; ++t)
+        files.insert(files.end(), filesOfThreads[t].begin(), filesOfThreads[t].end());
+    std::sort(files.begin(), files.end(), [](const inputFileInfo& f1, const inputFileInfo& f2) { return f1.path < f2.path; });
+
+    if (files.size() == 0)
+        cout << "no files matching " << pattern << " found in : " << dirname << endl;
+
+    // reuse the entry counts of the files that did not change
+    std::vector<int> toCount;
+    std::map<std::string, inputFileInfo> manifest;
+    if (manifestFileName != NULL)
+        manifest = readInputManifest(manifestFileName);
+    for (unsigned i = 0; i < files.size(); ++i)
+    {
+        std::map<std::string, inputFileInfo>::iterator it = manifest.find(files[i].path);
+        if (it != manifest.end() && it->second.size == files[i].size && it->second.mtime == files[i].mtime && it->second.entriesCounted)
+            files[i] = it->second;
+        else if (countEntries)
+            toCount.push_back(i);
+    }
+
+    if (toCount.size() > 0)
+    {
+        // every thread opens its own files
+        ROOT::EnableThreadSafety();
+        std::atomic<int> next(0);
+        threads.clear();
+        for (int t = 0; t < std::min(nThreads, (int)toCount.size()); ++t)
+        {
+            threads.push_back(std::thread([&files, &toCount, &next]() {
+                int i;
+                while ((i = next++) < (int)toCount.size())
+                {
+                    inputFileInfo* info = &files[toCount[i]];
+                    TFile* file = TFile::Open(info->path.c_str(), "READ");
+                    if (file == NULL || file->IsZombie())
+                    {
+                        delete file;
+                        continue;
+                    }
+                    countTreeEntries(file, "", info);
+                    info->entriesCounted = true;
+                    file->Close();
+                    delete file;
+                }
+            }));
+        }
+        for (unsigned t = 0; t < threads.size(); ++t)
+            threads[t].join();
+
+        for (unsigned i = 0; i < toCount.size(); ++i)
+        {
+            if (!files[toCount[i]].entriesCounted)
+                cout << "cannot open : " << files[toCount[i]].path << ", entries are not counted." << endl;
+        }
+    }
+
+    if (manifestFileName != NULL)
+        writeInputManifest(manifestFileName, files);
+
+    return files;
+}
+
+/*
+ * number of entries of tree "treeName" in the file, e.g. "hiEvtAnalyzer/HiTree". -1 if the entries were not counted.
+ * "treeName" = "" gives the entries of the first tree in the file.
+ */
+Long64_t getTreeEntries(const inputFileInfo& info, const char* treeName)
+{
+    for (unsigned i = 0; i < info.treeNames.size(); ++i)
+    {
+        if (strlen(treeName) == 0 || info.treeNames[i] == treeName)
+            return info.treeEntries[i];
+    }
+    return -1;
+}
+
+/*
+ * split "files" into "nParts" groups with about the same number of entries of tree "treeName", e.g. for parallel jobs.
+ * The size of the file is used for files whose entries were not counted.
+ * Files are assigned from the largest one to the group with the least entries. Returns the indices of the files of each group.
+ */
+std::vector<std::vector<int> > balanceInputFiles(const std::vector<inputFileInfo>& files, int nParts, const char* treeName /* ="" */)
+{
+    nParts = std::max(nParts, 1);
+    std::vector<std::pair<Long64_t, int> > weights;
+    for (unsigned i = 0; i < files.size(); ++i)
+    {
+        Long64_t entries = getTreeEntries(files[i], treeName);
+        weights.push_back(std::make_pair((entries >= 0) ? entries : files[i].size, (int)i));
+    }
+    // largest first, ties by index so that the result does not depend on the sort implementation
+    std::sort(weights.begin(), weights.end(), [](const std::pair<Long64_t, int>& w1, const std::pair<Long64_t, int>& w2) {
+        return (w1.first != w2.first) ? w1.first > w2.first : w1.second < w2.second;
+    });
+
+    std::vector<std::vector<int> > parts(nParts);
+    std::vector<Long64_t> totals(nParts, 0);
+    for (unsigned i = 0; i < weights.size(); ++i)
+    {
+        int part = std::min_element(totals.begin(), totals.end()) - totals.begin();
+        parts[part].push_back(weights[i].second);
+        totals[part] += weights[i].first;
+    }
+    for (int p = 0; p < nParts; ++p)
+        std::sort(parts[p].begin(), parts[p].end());
+
+    return parts;
+}
+
+/*
+ * true if "fileName" matches the glob "pattern", or ends with "pattern" if it has no wildcard
+ */
+bool matchFileName(const char* fileName, const char* pattern)
+{
+    if (strpbrk(pattern, "*?[") != NULL)
+        return fnmatch(pattern, fileName, 0) == 0;
+
+    size_t len = strlen(fileName);
+    size_t lenPattern = strlen(pattern);
+    return len >= lenPattern && strcmp(fileName + len - lenPattern, pattern) == 0;
+}
+
+/*
+ * worker of getInputFiles() : take directories from "dirs" until every directory is walked
+ */
+void findFilesInDirectories(std::deque<std::string>* dirs, int* nActive, std::mutex* mutex, std::condition_variable* condition,
+                            const char* pattern, std::vector<inputFileInfo>* files)
+{
+    while (true)
+    {
+        std::string dirname;
+        {
+            std::unique_lock<std::mutex> lock(*mutex);
+            // the walk is over when there is no directory left and no thread can add one
+            condition->wait(lock, [&] { return !dirs->empty() || *nActive == 0; });
+            if (dirs->empty())
+                break;
+            dirname = dirs->front();
+            dirs->pop_front();
+            ++(*nActive);
+        }
+
+        std::vector<std::string> subdirs;
+        DIR* dir = opendir(dirname.c_str());
+        if (dir != NULL)
+        {
+            struct dirent* entry;
+            while ((entry = readdir(dir)) != NULL)
+            {
+                std::string name = entry->d_name;
+                if (name == "." || name == "..")
+                    continue;
+
+                std::string path = dirname + "/" + name;
+                struct stat st;
+                if (lstat(path.c_str(), &st) != 0)
+                    continue;
+                if (S_ISDIR(st.st_mode))
+                {
+                    subdirs.push_back(path);
+                    continue;
+                }
+                if (S_ISLNK(st.st_mode) && (stat(path.c_str(), &st) != 0 || S_ISDIR(st.st_mode)))
+                    continue;
+                if (!S_ISREG(st.st_mode) || !matchFileName(name.c_str(), pattern))
+                    continue;
+
+                inputFileInfo info;
+                info.path = path;
+                info.size = st.st_size;
+                info.mtime = st.st_mtime;
+                info.entriesCounted = false;
+                files->push_back(info);
+            }
+            closedir(dir);
+        }
+        else
+        {
+            cout << "cannot read directory : " << dirname << endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(*mutex);
+            dirs->insert(dirs->end(), subdirs.begin(), subdirs.end());
+            --(*nActive);
+        }
+        condition->notify_all();
+    }
+}
+
+/*
+ * record the number of entries of the trees in "dir" and its subdirectories into "info"
+ */
+void countTreeEntries(TDirectory* dir, const std::string& prefix, inputFileInfo* info)
+{
+    std::vector<std::string> names;     // keys with several cycles are listed from the highest cycle
+    TIter next(dir->GetListOfKeys());
+    TKey* key;
+    while ((key=(TKey*)next()))
+    {
+        std::string name = prefix + key->GetName();
+        if (std::find(names.begin(), names.end(), name) != names.end())
+            continue;
+        names.push_back(name);
+
+        if (strcmp(key->GetClassName(), "TDirectoryFile") == 0)
+        {
+            countTreeEntries((TDirectory*)key->ReadObj(), name + "/", info);
+        }
+        else if (strcmp(key->GetClassName(), "TTree") == 0)
+        {
+            // reads the header of the tree, not its baskets
+            TTree* tree = (TTree*)key->ReadObj();
+            info->treeNames.push_back(name);
+            info->treeEntries.push_back(tree->GetEntries());
+        }
+    }
+}
+
+/*
+ * manifest written by writeInputManifest(), index is the path of the file
+ */
+std::map<std::string, inputFileInfo> readInputManifest(const char* manifestFileName)
+{
+    std::map<std::string, inputFileInfo> manifest;
+    std::ifstream in(manifestFileName);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.size() == 0 || line[0] == '#')
+            continue;
+
+        // path <tab> size <tab> mtime <tab> entriesCounted {<tab> tree <tab> entries}
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() < 4 || fields.size() % 2 != 0)
+            continue;
+
+        inputFileInfo info;
+        info.path = fields[0];
+        info.size = atoll(fields[1].c_str());
+        info.mtime = atoll(fields[2].c_str());
+        info.entriesCounted = (fields[3] == "1");
+        for (unsigned i = 4; i + 1 < fields.size(); i += 2)
+        {
+            info.treeNames.push_back(fields[i]);
+            info.treeEntries.push_back(atoll(fields[i+1].c_str()));
+        }
+        manifest[info.path] = info;
+    }
+    return manifest;
+}
+
+/*
+ * write "files" into a text file, one line per file with tab separated fields :
+ * path, size, modification time, 1 if the entries are counted, then the name and the entries of each tree
+ */
+void writeInputManifest(const char* manifestFileName, const std::vector<inputFileInfo>& files)
+{
+    std::ofstream out(manifestFileName);
+    if (!out.is_open())
+    {
+        cout << "cannot write manifest : " << manifestFileName << endl;
+        return;
+    }
+
+    out << "# path\tsize\tmtime\tentriesCounted\t{tree\tentries}" << endl;
+    for (unsigned i = 0; i < files.size(); ++i)
+    {
+        out << files[i].path << "\t" << files[i].size << "\t" << files[i].mtime << "\t" << (files[i].entriesCounted ? 1 : 0);
+        for (unsigned j = 0; j < files[i].treeNames.size(); ++j)
+            out << "\t" << files[i].treeNames[j] << "\t" << files[i].treeEntries[j];
+        out << "\n";
+    }
+}
 
 #endif /* SYSTEMUTIL_H_ */
@@ -1,16 +1,31 @@
 /*
  * utilities related to TTree objects.
  *
+ * The draw functions with a supplied histogram, e.g. drawMaximum(), fill it through drawCached() instead of TTree::Draw().
+ * They fill the same histogram, for the entries of the entry list of the tree if one is set, but they do not draw it
+ * on the current pad : call hist->Draw() to display it.
  */
 
 #ifndef TREEUTIL_H_
 #define TREEUTIL_H_
 
 #include <TTree.h>
+#include <TBranch.h>
 #include <TH1.h>
 #include <TFile.h>
+#include <TMath.h>
+#include <TROOT.h>
+#include <TList.h>
+#include <TFriendElement.h>
+#include <TTreeFormula.h>
+#include <TTreeFormulaManager.h>
+#include <TEntryList.h>
 
-#include <cstdarg>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "CutExpression.h"
 
 void drawMaximum(TTree* tree, TString formula, TString condition = "1", TH1* hist = NULL, bool plotZero = false);
 void drawMaximum(TTree* tree, TString formula, TString condition = "1", TString cut = "1", TH1* hist = NULL, bool plotZero = false);
@@ -20,12 +35,66 @@ void drawMaximum2nd(TTree* tree, TString formula, TString condition = "1", TH1*
 void drawMaximum2nd(TTree* tree, TString formula, TString condition = "1", TString cut = "1", TH1* hist = NULL, bool plotZero = false);
 void drawMaximum2ndGeneral(TTree* tree, TString formula, TString formulaForMax, TString conditionForMax = "1", TH1* hist = NULL);
 void drawMaximum2ndGeneral(TTree* tree, TString formula, TString formulaForMax, TString conditionForMax = "1", TString cut = "1", TH1* hist = NULL);
+TString getMaximumFormula     (TString formula, TString condition);
+TString getMaximum2ndFormula  (TString formula, TString condition);
+TString getMaximumSelection   (TString formulaForMax, TString conditionForMax);
+TString getMaximum2ndSelection(TString formulaForMax, TString conditionForMax);
 
 bool compareTrees(TTree* tree1, TTree* tree2, int lenBranchNames = 0, const char* branchNames[] = NULL);
 bool compareTrees(TFile* file1, const char* tree1Path, TFile* file2, const char* tree2Path, int lenBranchNames = 0, const char* branchNames[] = NULL);
 
 TString mergeCuts(TString cut1, TString cut2);
-TString mergeCuts2(int nCuts, ...);
+TString mergeCuts(int nCuts, const char* cuts[]);
+template <typename... Cuts> TString mergeCuts2(int nCuts, Cuts... cuts);
+TString mergeCuts2(int nCuts);
+
+Long64_t getClusterSize(TTree* tree);
+Long64_t estimateCacheSize(TTree* tree, int lenBranchNames, const char* branchNames[], int nClusters = 2);
+void     setCacheForBranches(TTree* tree, int lenBranchNames, const char* branchNames[], Long64_t cacheSize = -1, int learnEntries = 0);
+void     setImplicitMTPoolSize(int nThreads);
+
+// compiled formulas of a draw : "var" is filled for the elements where "select" is nonzero, same as TTree::Draw()
+struct compiledDraw {
+    TTree*   tree;
+    TString  friendSignature;       // friends of "tree" when the formulas were compiled, see getFriendSignature()
+    TTreeFormula* var;
+    TTreeFormula* select;
+    TTreeFormulaManager* manager;   // keeps the number of elements of "var" and "select" in sync, deleted with the formulas
+};
+
+/*
+ * cache of the compiled formulas of the draws, keyed by (tree, varexp, selection).
+ * TTree::Draw() parses and compiles its formulas at every call, drawCached() takes them from this cache instead.
+ *
+ * Formulas of a tree are compiled again if the friends of the tree have changed since they were compiled,
+ * e.g. after GammaJetAnalyzer::setJetTree(). The cache is in the list of cleanups of ROOT,
+ * so the formulas of a tree are deleted when the tree is deleted, e.g. when its file is closed.
+ */
+class TreeFormulaCache : public TObject {
+public:
+    TreeFormulaCache();
+    virtual ~TreeFormulaCache();
+
+    compiledDraw* get(TTree* tree, const char* varexp, const char* selection);
+    void     clear(TTree* tree = NULL);
+    int      getNFormulas() const;
+    Long64_t getNHits() const;
+    Long64_t getNMisses() const;
+    virtual void RecursiveRemove(TObject* obj);
+
+private:
+    void deleteDraw(compiledDraw& draw);
+
+    std::map<std::string, compiledDraw> draws;
+    Long64_t nHits;
+    Long64_t nMisses;
+};
+
+TreeFormulaCache* getFormulaCache();
+void     clearFormulaCache(TTree* tree = NULL);
+TString  getFriendSignature(TTree* tree);
+Long64_t drawCached(TTree* tree, TString varexp, TString selection, TH1* hist);
+void     drawFormula(TTree* tree, TString varexp, TString selection, TH1* hist, const char* hname);
 
 /*
  * plot the maximum value of the elements of a "formula" where the elements satisfy the "condition".
@@ -43,11 +112,10 @@ void drawMaximum(TTree* tree, TString formula, TString condition, TH1* hist, boo
     }
 
     if(plotZero) {
-        tree->Draw(Form("Max$(%s*(%s)) >> %s",formula.Data(), condition.Data(), hname));
+        drawFormula(tree, getMaximumFormula(formula, condition), "1", hist, hname);
     }
     else {
-        tree->Draw(Form("Max$(%s*(%s)) >> %s",formula.Data(), condition.Data(), hname), Form("%s == Max$(%s*(%s))",
-                                                                                        formula.Data(), formula.Data(), condition.Data()));
+        drawFormula(tree, getMaximumFormula(formula, condition), getMaximumSelection(formula, condition), hist, hname);
 //        drawMaximumGeneral(tree, formula, formula, condition, hist);
     }
 }
@@ -71,12 +139,10 @@ void drawMaximum(TTree* tree, TString formula, TString condition, TString cut, T
     }
 
     if(plotZero){
-        tree->Draw(Form("Max$(%s*(%s)) >> %s",formula.Data(), condition.Data(), hname), cut.Data());
+        drawFormula(tree, getMaximumFormula(formula, condition), cut, hist, hname);
     }
     else {
-        tree->Draw(Form("Max$(%s*(%s)) >> %s",formula.Data(), condition.Data(), hname), Form("%s == Max$(%s*(%s)) && %s",
-                                                                                        formula.Data(), formula.Data(), condition.Data(),
-                                                                                        cut.Data()));
+        drawFormula(tree, getMaximumFormula(formula, condition), mergeCuts(getMaximumSelection(formula, condition), cut), hist, hname);
 //        drawMaximumGeneral(tree, formula, formula, condition, cut, hist);
     }
 }
@@ -97,7 +163,7 @@ void drawMaximumGeneral(TTree* tree, TString formula, TString formulaForMax, TSt
     {
        hname = hist->GetName();
     }
-    tree->Draw(Form("%s >> %s", formula.Data(), hname) ,Form("%s == Max$(%s*(%s))",formulaForMax.Data() ,formulaForMax.Data() ,conditionForMax.Data()));
+    drawFormula(tree, formula, getMaximumSelection(formulaForMax, conditionForMax), hist, hname);
 }
 
 /*
@@ -117,7 +183,7 @@ void drawMaximumGeneral(TTree* tree, TString formula, TString formulaForMax, TSt
     {
        hname = hist->GetName();
     }
-    tree->Draw(Form("%s >> %s", formula.Data(), hname) ,Form("%s == Max$(%s*(%s)) && %s",formulaForMax.Data() ,formulaForMax.Data() ,conditionForMax.Data() ,cut.Data()));
+    drawFormula(tree, formula, mergeCuts(getMaximumSelection(formulaForMax, conditionForMax), cut), hist, hname);
 }
 
 /*
@@ -136,8 +202,7 @@ void drawMaximum2nd(TTree* tree, TString formula, TString condition, TH1* hist,
     }
 
     if(plotZero) {
-        tree->Draw(Form("Max$(%s*(%s < Max$(%s*(%s)))*(%s)) >> %s",formula.Data(),formula.Data(),formula.Data(),
-                                                                    condition.Data(), condition.Data(), hname));
+        drawFormula(tree, getMaximum2ndFormula(formula, condition), "1", hist, hname);
     }
     else {
         drawMaximum2ndGeneral(tree, formula, formula, condition, hist);
@@ -161,9 +226,7 @@ void drawMaximum2nd(TTree* tree, TString formula, TString condition, TString cut
     }
 
     if(plotZero) {
-        tree->Draw(Form("Max$(%s*(%s < Max$(%s*(%s)))*(%s)) >> %s",formula.Data(),formula.Data(),formula.Data(),
-                                                                    condition.Data(), condition.Data(), hname),
-                                                                    cut.Data());
+        drawFormula(tree, getMaximum2ndFormula(formula, condition), cut, hist, hname);
     }
     else {
         drawMaximum2ndGeneral(tree, formula, formula, condition, cut, hist);
@@ -186,8 +249,7 @@ void drawMaximum2ndGeneral(TTree* tree, TString formula, TString formulaForMax,
     {
        hname = hist->GetName();
     }
-    tree->Draw(Form("%s >> %s", formula.Data(), hname) ,Form("%s == Max$(%s*(%s < Max$(%s*(%s)))*(%s))",formulaForMax.Data() ,formulaForMax.Data() ,formulaForMax.Data() ,formulaForMax.Data() ,
-                                                                                                              conditionForMax.Data() ,conditionForMax.Data()));
+    drawFormula(tree, formula, getMaximum2ndSelection(formulaForMax, conditionForMax), hist, hname);
 }
 
 /*
@@ -207,8 +269,39 @@ void drawMaximum2ndGeneral(TTree* tree, TString formula, TString formulaForMax,
     {
        hname = hist->GetName();
     }
-    tree->Draw(Form("%s >> %s", formula.Data(), hname) ,Form("%s == Max$(%s*(%s < Max$(%s*(%s)))*(%s)) && %s",formulaForMax.Data() ,formulaForMax.Data() ,formulaForMax.Data() ,formulaForMax.Data() ,
-                                                                                                              conditionForMax.Data() ,conditionForMax.Data() ,cut.Data()));
+    drawFormula(tree, formula, mergeCuts(getMaximum2ndSelection(formulaForMax, conditionForMax), cut), hist, hname);
+}
+
+/*
+ * maximum value of the elements of "formula" that satisfy "condition", 0 if no element satisfies "condition"
+ */
+TString getMaximumFormula(TString formula, TString condition)
+{
+    return Form("Max$(%s*(%s))", formula.Data(), condition.Data());
+}
+
+/*
+ * 2nd maximum value of the elements of "formula" that satisfy "condition", 0 if less than two elements satisfy "condition"
+ */
+TString getMaximum2ndFormula(TString formula, TString condition)
+{
+    return Form("Max$(%s*(%s < %s)*(%s))", formula.Data(), formula.Data(), getMaximumFormula(formula, condition).Data(), condition.Data());
+}
+
+/*
+ * selection of the element with maximum value for "formulaForMax" among the elements that satisfy "conditionForMax"
+ */
+TString getMaximumSelection(TString formulaForMax, TString conditionForMax)
+{
+    return Form("%s == %s", formulaForMax.Data(), getMaximumFormula(formulaForMax, conditionForMax).Data());
+}
+
+/*
+ * selection of the element with 2nd maximum value for "formulaForMax" among the elements that satisfy "conditionForMax"
+ */
+TString getMaximum2ndSelection(TString formulaForMax, TString conditionForMax)
+{
+    return Form("%s == %s", formulaForMax.Data(), getMaximum2ndFormula(formulaForMax, conditionForMax).Data());
 }
 
 /*
@@ -288,43 +381,367 @@ bool compareTrees(TFile* file1, const char* tree1Path, TFile* file2, const char*
     return compareTrees(t1, t2, lenBranchNames, branchNames);
 }
 
+/*
+ * "cut1 && cut2" where duplicate terms and tautologies like "1" are removed, see CutExpression.h
+ */
 TString mergeCuts(TString cut1, TString cut2)
 {
-    TString cut = Form("%s && %s", cut1.Data(), cut2.Data());
-    return cut;
+    const char* cuts[] = {cut1.Data(), cut2.Data()};
+    return mergeCuts(2, cuts);
+}
+
+/*
+ * merge the first "nCuts" cuts of the array "cuts", empty cuts are ignored.
+ * A single non-empty cut is only simplified, e.g. the weight "w" stays a weight.
+ */
+TString mergeCuts(int nCuts, const char* cuts[])
+{
+    CutExpression cut;
+    bool empty = true;
+    for (int i = 0; i < nCuts; ++i) {
+        if (cuts[i] == NULL || TString(cuts[i]).Strip(TString::kBoth).Length() == 0)  continue;
+
+        if (empty)  cut = CutExpression(cuts[i]);
+        else        cut.merge(CutExpression(cuts[i]));
+        empty = false;
+    }
+    cut.simplify();
+    return cut.toString();
 }
 
 /*
  * function to merge a variable number of cuts.
  * The cuts are of type "const char*"
- * assumes that "nCuts" matches the number of cuts entered in the function call
+ * The number of cuts entered in the function call is known at compile time, so only the given cuts are read :
+ * if "nCuts" is smaller, the first "nCuts" cuts are merged, if it is larger, all the given cuts are merged.
  *
- * http://en.cppreference.com/w/cpp/utility/variadic
- * http://en.cppreference.com/w/cpp/language/variadic_arguments
- * http://www.cplusplus.com/reference/cstdarg/va_arg/
- * http://www.cplusplus.com/reference/cstdarg/
+ * http://en.cppreference.com/w/cpp/language/parameter_pack
  *
  * */
-TString mergeCuts2(int nCuts, ...)
+template <typename... Cuts> TString mergeCuts2(int nCuts, Cuts... cuts)
+{
+    const char* cutArray[] = {cuts...};
+    const int nGiven = sizeof...(cuts);
+    if (nCuts > nGiven) {
+        std::cout << "mergeCuts2 : nCuts = " << nCuts << " but " << nGiven << " cuts are given, only the given cuts are merged." << std::endl;
+        nCuts = nGiven;
+    }
+    return mergeCuts(nCuts, cutArray);
+}
+
+TString mergeCuts2(int nCuts)
+{
+    if (nCuts > 0) {
+        std::cout << "mergeCuts2 : nCuts = " << nCuts << " but no cut is given." << std::endl;
+    }
+    return "1";
+}
+
+/*
+ * number of entries in the first cluster of the tree.
+ * Baskets of all branches are flushed together at cluster boundaries, see TTree::SetAutoFlush().
+ */
+Long64_t getClusterSize(TTree* tree)
+{
+    Long64_t entries = tree->GetEntries();
+    if(entries <= 0)  return 0;
+
+    TTree::TClusterIterator clusterIter = tree->GetClusterIterator(0);
+    Long64_t start = clusterIter();
+    Long64_t end = clusterIter.GetNextEntry();
+    if(end <= start || end > entries)  end = entries;
+
+    return end - start;
+}
+
+/*
+ * size in bytes of a TTreeCache that holds "nClusters" clusters of the compressed baskets of the given branches.
+ * returns 0 if none of the branches exists.
+ */
+Long64_t estimateCacheSize(TTree* tree, int lenBranchNames, const char* branchNames[], int nClusters)
+{
+    Long64_t entries = tree->GetEntries();
+    if(entries <= 0)  return 0;
+
+    Long64_t zipBytes = 0;
+    for(int i=0; i<lenBranchNames; ++i)
+    {
+        TBranch* branch = tree->GetBranch(branchNames[i]);
+        if(branch != NULL)  {
+            zipBytes += branch->GetZipBytes("*");
+        }
+    }
+
+    double zipBytesPerEntry = (double)zipBytes / entries;
+    return (Long64_t)(zipBytesPerEntry * getClusterSize(tree) * nClusters);
+}
+
+/*
+ * set up the TTreeCache of "tree" for the given branches.
+ * If cacheSize < 0, the size is estimated from the compressed size of the branches, see estimateCacheSize().
+ *
+ * If learnEntries > 0, the cache keeps learning the branches that are read during the first "learnEntries" entries,
+ * e.g. branches used by formulas in TTree::Draw(). Otherwise only the given branches are cached.
+ * The number of learning entries is a global setting (TTreeCache::SetLearnEntries()) that a cache reads when it is created,
+ * so it is set before the cache and applies to the caches created afterwards for any tree.
+ *
+ * https://root.cern.ch/root/html/TTreeCache.html
+ */
+void setCacheForBranches(TTree* tree, int lenBranchNames, const char* branchNames[], Long64_t cacheSize, int learnEntries)
+{
+    if(cacheSize < 0)  {
+        // ROOT needs a minimum cache to be useful, 1 MB is the smallest size that makes sense for a network file system.
+        cacheSize = TMath::Max(estimateCacheSize(tree, lenBranchNames, branchNames), (Long64_t)1000000);
+    }
+
+    if(learnEntries > 0)  {
+        tree->SetCacheLearnEntries(learnEntries);
+    }
+
+    tree->SetCacheSize(cacheSize);
+    for(int i=0; i<lenBranchNames; ++i)
+    {
+        tree->AddBranchToCache(branchNames[i], kTRUE);
+    }
+
+    if(learnEntries <= 0)  {
+        tree->StopCacheLearningPhase();
+    }
+}
+
+/*
+ * enable ROOT's implicit multithreading with a thread pool of "nThreads" threads, nThreads <= 0 uses all cores.
+ * The pool is global, if it is already enabled with a different size then it is created again.
+ *
+ * https://root.cern.ch/doc/master/namespaceROOT.html
+ */
+void setImplicitMTPoolSize(int nThreads)
+{
+    UInt_t poolSize = (nThreads > 0) ? nThreads : 0;    // 0 means all cores for ROOT
+    if(ROOT::IsImplicitMTEnabled() && poolSize > 0 && ROOT::GetThreadPoolSize() != poolSize)  {
+        ROOT::DisableImplicitMT();
+    }
+    if(!ROOT::IsImplicitMTEnabled())  {
+        ROOT::EnableImplicitMT(poolSize);
+    }
+}
+
+TreeFormulaCache::TreeFormulaCache() :
+        nHits(0), nMisses(0)
+{
+}
+
+TreeFormulaCache::~TreeFormulaCache()
+{
+    clear();
+    if (gROOT != NULL)  gROOT->GetListOfCleanups()->Remove(this);
+}
+
+/*
+ * compiled formulas of "varexp" and "selection" for "tree", compiled at the first call.
+ * returns NULL if one of the formulas is not valid.
+ */
+compiledDraw* TreeFormulaCache::get(TTree* tree, const char* varexp, const char* selection)
+{
+    if (selection == NULL || selection[0] == '\0')  selection = "1";
+
+    std::string key = Form("%p", (void*)tree);
+    key += '\n';
+    key += varexp;
+    key += '\n';
+    key += selection;
+
+    TString friendSignature = getFriendSignature(tree);
+    std::map<std::string, compiledDraw>::iterator it = draws.find(key);
+    if (it != draws.end()) {
+        if (it->second.friendSignature == friendSignature) {
+            nHits++;
+            return &(it->second);
+        }
+        // friends have changed, formulas may refer to a tree that is not a friend anymore
+        deleteDraw(it->second);
+        draws.erase(it);
+    }
+    nMisses++;
+
+    compiledDraw draw;
+    draw.tree = tree;
+    draw.friendSignature = friendSignature;
+    draw.var = new TTreeFormula("drawVar", varexp, tree);
+    draw.select = new TTreeFormula("drawSelect", selection, tree);
+    if (draw.var->GetNdim() == 0 || draw.select->GetNdim() == 0) {
+        std::cout << "TreeFormulaCache : formula is not valid for tree " << tree->GetName() << " : "
+                  << ((draw.var->GetNdim() == 0) ? varexp : selection) << std::endl;
+        delete draw.var;
+        delete draw.select;
+        return NULL;
+    }
+    draw.manager = new TTreeFormulaManager();
+    draw.manager->Add(draw.select);
+    draw.manager->Add(draw.var);
+    draw.manager->Sync();
+
+    // the cache is notified when the tree is deleted
+    tree->SetBit(kMustCleanup);
+    return &(draws[key] = draw);
+}
+
+/*
+ * delete the formulas of "tree", NULL deletes every formula
+ */
+void TreeFormulaCache::clear(TTree* tree)
+{
+    std::map<std::string, compiledDraw>::iterator it = draws.begin();
+    while (it != draws.end()) {
+        if (tree == NULL || it->second.tree == tree) {
+            deleteDraw(it->second);
+            draws.erase(it++);
+        }
+        else  ++it;
+    }
+}
+
+int TreeFormulaCache::getNFormulas() const
 {
-    va_list vl;
-    va_start(vl,nCuts);
+    return draws.size();
+}
 
-    TString cutNext = va_arg(vl, const char*);
-    TString cut = cutNext.Data();
-    if(nCuts == 1 && cutNext.Length() > 0)
-        return cut;
+Long64_t TreeFormulaCache::getNHits() const
+{
+    return nHits;
+}
+
+Long64_t TreeFormulaCache::getNMisses() const
+{
+    return nMisses;
+}
+
+/*
+ * called by ROOT when an object in the list of cleanups is deleted
+ */
+void TreeFormulaCache::RecursiveRemove(TObject* obj)
+{
+    clear((TTree*)obj);
+}
 
-    for (int i=1; i<nCuts; ++i)
+void TreeFormulaCache::deleteDraw(compiledDraw& draw)
+{
+    // the manager is deleted with its last formula
+    delete draw.var;
+    delete draw.select;
+    draw.var = NULL;
+    draw.select = NULL;
+    draw.manager = NULL;
+}
+
+/*
+ * the formula cache used by the draw functions of this file
+ */
+TreeFormulaCache* getFormulaCache()
+{
+    static TreeFormulaCache* cache = NULL;
+    if (cache == NULL) {
+        cache = new TreeFormulaCache();
+        gROOT->GetListOfCleanups()->Add(cache);
+    }
+    return cache;
+}
+
+/*
+ * delete the cached formulas of "tree", NULL deletes every formula.
+ * Formulas are compiled again when the friends of a tree change, this only frees the memory of the old formulas.
+ */
+void clearFormulaCache(TTree* tree)
+{
+    getFormulaCache()->clear(tree);
+}
+
+/*
+ * string that identifies the friends of "tree" : alias and address of each friend tree
+ */
+TString getFriendSignature(TTree* tree)
+{
+    TString signature = "";
+    TList* friends = tree->GetListOfFriends();
+    if (friends == NULL)  return signature;
+
+    TIter next(friends);
+    TFriendElement* friendElement;
+    while ((friendElement = (TFriendElement*)next())) {
+        signature += Form("%s:%p;", friendElement->GetName(), (void*)friendElement->GetTree());
+    }
+    return signature;
+}
+
+/*
+ * same as tree->Draw("varexp >> hist", selection, "goff") for a 1D "varexp", but the compiled formulas are taken from the formula cache.
+ * An element of "varexp" is filled with the value of the corresponding element of "selection" as weight,
+ * elements where "selection" is 0 are not filled. Only the entries of the entry list of the tree are read if one is set,
+ * e.g. by tree->SetEntryList() or tree->SetEventList(). The histogram is not drawn.
+ * returns the number of filled elements, -1 if a formula is not valid.
+ */
+Long64_t drawCached(TTree* tree, TString varexp, TString selection, TH1* hist)
+{
+    compiledDraw* draw = getFormulaCache()->get(tree, varexp.Data(), selection.Data());
+    if (draw == NULL)  return -1;
+
+    const bool selectMultiple = (draw->select->GetMultiplicity() != 0);
+    const Double_t treeWeight = tree->GetWeight();
+    // GetEntryNumber() gives the entries of the entry list, TTree::SetEventList() sets an entry list as well
+    TEntryList* entryList = tree->GetEntryList();
+    Long64_t entries = (entryList != NULL) ? entryList->GetN() : tree->GetEntries();
+    Long64_t nFilled = 0;
+    int treeNumber = -1;
+    for (Long64_t j = 0; j < entries; ++j)
     {
-        cutNext = va_arg(vl, const char*);
-        if(cutNext.Length() > 0){
-            cut = Form("%s && %s", cut.Data(), cutNext.Data());
+        Long64_t entry = tree->GetEntryNumber(j);
+        if (entry < 0 || tree->LoadTree(entry) < 0)  break;
+        if (tree->GetTreeNumber() != treeNumber) {
+            // next tree of a chain
+            treeNumber = tree->GetTreeNumber();
+            draw->var->UpdateFormulaLeaves();
+            draw->select->UpdateFormulaLeaves();
+        }
+
+        int nData = draw->manager->GetNdata(kTRUE);
+        if (nData <= 0)  continue;
+
+        // instance 0 loads the branches of the formulas for this entry, same as TSelectorDraw
+        Double_t weight0 = draw->select->EvalInstance(0);
+        if (weight0 == 0 && !selectMultiple)  continue;
+        Double_t value0 = draw->var->EvalInstance(0);
+        if (weight0 != 0) {
+            hist->Fill(value0, treeWeight * weight0);
+            nFilled++;
+        }
+
+        for (int i = 1; i < nData; ++i)
+        {
+            Double_t weight = (selectMultiple) ? draw->select->EvalInstance(i) : weight0;
+            if (weight == 0)  continue;
+
+            hist->Fill(draw->var->EvalInstance(i), treeWeight * weight);
+            nFilled++;
         }
     }
-    va_end(vl);
+    return nFilled;
+}
 
-    return cut;
+/*
+ * fill "hist" with "varexp" for the elements that pass "selection" using the formula cache, see drawCached().
+ * The histogram is reset before, same as TTree::Draw(), but it is not drawn.
+ * If no histogram is supplied, TTree::Draw() creates the histogram "hname".
+ */
+void drawFormula(TTree* tree, TString varexp, TString selection, TH1* hist, const char* hname)
+{
+    if (hist != NULL) {
+        // TTree::Draw("varexp >> hist") resets the histogram as well
+        hist->Reset();
+        drawCached(tree, varexp, selection, hist);
+    }
+    else {
+        tree->Draw(Form("%s >> %s", varexp.Data(), hname), selection.Data());
+    }
 }
 
 #endif /* TREEUTIL_H_ */